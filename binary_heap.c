@@ -13,6 +13,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sched.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "binary_heap.h"
 #include "pthread.h"
 
@@ -27,153 +32,1169 @@
  *
  *   array:  [a, b, c, d, e, f]
  *
+ *  B-heap layout (PRIQ_LAYOUT_BHEAP, P.-H. Kamp):
+ *   the array is cut into pages of 'page nodes', every page keeps a subtree,
+ *   so a sift walks through about log(n)/log(page nodes) pages.
+ *   - inside a page, the children of offset x are 2x and 2x+1.
+ *   - the bottom row of a page (offset >= page/2) has its children
+ *     at offset 0 and 1 of a new page.
+ *   - offset 0 and 1 (except the first page) have only one child, offset 2 and 3.
+ *   the array is still filled densely, the index 0 isn't used.
  */
 
 //=============================================================================
 //                  Constant Definition
 //=============================================================================
+/**
+ *  batch update: rebuild the whole heap when 'num * log2(node count)' is
+ *  larger than 'node count * PRIQ_BATCH_REBUILD_FACTOR'
+ */
+#define PRIQ_BATCH_REBUILD_FACTOR       2
+
+/**
+ *  parallel heapify: a level is split across workers only when it has at least
+ *  this many parent nodes, the upper (smaller) levels are finished by one thread.
+ */
+#define PRIQ_PARALLEL_LEVEL_MIN_NODES   4096
+
+/**
+ *  parallel heapify: heaps with fewer nodes are always rebuilt by the caller thread
+ */
+#define PRIQ_PARALLEL_HEAPIFY_MIN_NODES (PRIQ_PARALLEL_LEVEL_MIN_NODES << 2)
+
+#define PRIQ_CACHE_LINE_SIZE            64
+
+/**
+ *  size alignment of a explicit huge page mapping (2MB)
+ */
+#define PRIQ_HUGE_PAGE_SIZE             (2ul << 20)
+
+/**
+ *  batch insert: the priorities of the new nodes and their parents
+ *  are prefetched this many nodes ahead
+ */
+#define PRIQ_PREFETCH_NODES             8
 
+/**
+ *  state of a flat combining slot
+ */
+typedef enum fc_slot_state
+{
+    FC_SLOT_FREE        = 0,
+    FC_SLOT_BUSY,           // claimed by a thread, filling the request
+    FC_SLOT_PENDING,        // published, wait for a combiner
+    FC_SLOT_COMBINING,      // taken by the combiner
+    FC_SLOT_DONE,
+
+} fc_slot_state_t;
 //=============================================================================
 //                  Macro Definition
 //=============================================================================
 #define err(str, args...)       fprintf(stderr, "%s[#%d] " str, __func__, __LINE__, ## args)
 
 
-#define LEFT(x)         ((x) << 1)
-#define RIGHT(x)        (((x) << 1) + 1)
-#define PARENT(x)       ((x) >> 1)
+#define LEFT(x)         ((x) << 1)
+#define RIGHT(x)        (((x) << 1) + 1)
+#define PARENT(x)       ((x) >> 1)
+
+#define priq_parent(pDev, x)    (((pDev)->layout == PRIQ_LAYOUT_BHEAP) ? _bheap_parent(pDev, x) : PARENT(x))
+
+
+#ifndef MEMBER_OFFSET
+    #define MEMBER_OFFSET(type, member)     (unsigned long)&(((type *)0)->member)
+#endif
+
+#ifndef STRUCTURE_POINTER
+    #define STRUCTURE_POINTER(type, ptr, member)    (type*)((unsigned long)ptr - MEMBER_OFFSET(type, member))
+#endif
+
+#define priq_verify_handle(handle, err_code)            \
+            do{ if(handle==NULL){                       \
+                err("%s", "input Null pointer !!\n");   \
+                return err_code;}                       \
+            }while(0)
+
+
+
+/**
+ *  position callbacks, the 64-bit ones are used if they exist
+ */
+#define priq_pos_set(pDev, pNode, idx)                              \
+            ((pDev)->cb_pos_set64 ? (pDev)->cb_pos_set64(pNode, idx) \
+                                  : (pDev)->cb_pos_set(pNode, (int)(idx)))
+
+#define priq_pos_get(pDev, pNode)                                   \
+            ((pDev)->cb_pos_get64 ? (long)(pDev)->cb_pos_get64(pNode) \
+                                  : (long)(pDev)->cb_pos_get(pNode))
+
+
+#define priq_update_remain(pDev)                                    \
+            ((pDev)->hPriq.remain_num = (pDev)->node_cnt - 1 + (pDev)->ins_buf_cnt)
+
+
+#define priq_trace_op(pDev, op, pNode)                              \
+            do{ if((pDev)->cb_trace)                                \
+                (pDev)->cb_trace((pDev)->pTrace_priv, op, pNode,    \
+                                 (pDev)->cb_pri_get(pNode));        \
+            }while(0)
+
+
+#define priq_mutex_init(pMtx)               pthread_mutex_init(pMtx, NULL)
+#define priq_mutex_deinit(pMtx)             pthread_mutex_destroy(pMtx)
+#define priq_mutex_lock(pMtx)               pthread_mutex_lock(pMtx)
+#define priq_mutex_unlock(pMtx)             pthread_mutex_unlock(pMtx)
+//=============================================================================
+//                  Structure Definition
+//=============================================================================
+/**
+ *  flat combining publication slot, one cache line per slot
+ */
+typedef struct fc_slot
+{
+    int                 state;
+    priq_op_t           op;
+    void                *pNode;     // the popped node for PRIQ_OP_POP
+    priq_priority_t     *pPri;
+    priq_err_t          rval;
+
+} __attribute__((aligned(PRIQ_CACHE_LINE_SIZE))) fc_slot_t;
+
+typedef struct priq_dev
+{
+    priq_t              hPriq;
+
+    pthread_mutex_t     mutex;
+
+    long                node_cnt;
+    long                max_nodes;
+
+    CB_PRIORITY_GET     cb_pri_get;
+    CB_PRIORITY_SET     cb_pri_set;
+    CB_PRIORITY_CMP     cb_pri_cmp;
+
+    CB_POSITION_GET     cb_pos_get;
+    CB_POSITION_SET     cb_pos_set;
+    CB_POSITION_GET64   cb_pos_get64;
+    CB_POSITION_SET64   cb_pos_set64;
+
+    int                 worker_threads;
+    struct heapify_pool *pHeapify_pool;
+
+    CB_TRACE_OP         cb_trace;
+    void                *pTrace_priv;
+
+    // flat combining
+    int                 fc_slot_num;
+    fc_slot_t           *pFc_slots;
+    void                **ppFc_push_nodes;
+
+    // node list storage
+    priq_storage_t      storage;
+    priq_huge_page_t    huge_page;
+
+    /**
+     *  insertion buffer, the pushed nodes wait here without a position,
+     *  they are merged into the heap before any other operation.
+     */
+    int                 ins_buf_size;
+    int                 ins_buf_cnt;
+    void                **ppIns_buf;
+
+    // B-heap layout
+    priq_layout_t       layout;
+    int                 page_shift;
+    long                page_mask;
+
+    int                 is_growable;
+    int                 fd;
+    unsigned long       map_size;
+
+    void                **ppNode_list;
+
+} priq_dev_t;
+
+struct heapify_pool;
+
+typedef struct heapify_worker
+{
+    struct heapify_pool     *pPool;
+    pthread_t               tid;
+    int                     worker_id;
+
+} heapify_worker_t;
+
+/**
+ *  parallel heapify worker pool, the workers live as long as the queue.
+ *  a rebuild publishes the range and bumps 'generation' to wake them up.
+ */
+typedef struct heapify_pool
+{
+    priq_dev_t          *pDev;
+
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond_start;
+    pthread_barrier_t   barrier;
+    unsigned long       generation;
+    int                 is_quit;
+
+    // worker 0 is the caller thread of the rebuild
+    int                 worker_num;
+    heapify_worker_t    *pWorkers;
+
+    // the lowest level which is split across the workers
+    long                level_start;
+    long                last_parent;
+
+} heapify_pool_t;
+//=============================================================================
+//                  Global Data Definition
+//=============================================================================
+static int              g_fc_thread_cnt = 0;
+static __thread int     g_fc_slot_hint = -1;
+
+//=============================================================================
+//                  Private Function Definition
+//=============================================================================
+static long
+_bheap_parent(
+    priq_dev_t  *pDev,
+    long        idx)
+{
+    long        page_mask = pDev->page_mask;
+    long        offset = idx & page_mask;
+    long        parent_idx = 0l;
+
+    // the first page or inside a page
+    if( idx <= page_mask || offset > 3 )
+        return (idx & ~page_mask) | (offset >> 1);
+
+    if( offset > 1 )
+        return idx - 2;
+
+    // offset 0/1: the bottom row node of the parent page
+    parent_idx  = (idx - (page_mask + 1)) >> pDev->page_shift;
+    parent_idx += parent_idx & ~(page_mask >> 1);
+    parent_idx |= (page_mask + 1) >> 1;
+
+    return parent_idx;
+}
+
+static long
+_bheap_child(
+    priq_dev_t  *pDev,
+    long        idx,
+    long        *pRight_idx)
+{
+    long        page_mask = pDev->page_mask;
+    long        left_idx = 0l;
+
+    if( idx > page_mask && (idx & (page_mask - 1)) == 0 )
+    {
+        // offset 0/1 has only one child
+        left_idx = idx + 2;
+        *pRight_idx = left_idx;
+    }
+    else if( idx & ((page_mask + 1) >> 1) )
+    {
+        // the bottom row, the children are at the head of a new page
+        left_idx  = (idx & ~page_mask) >> 1;
+        left_idx |= idx & (page_mask >> 1);
+        left_idx  = (left_idx + 1) << pDev->page_shift;
+        *pRight_idx = left_idx + 1;
+    }
+    else
+    {
+        left_idx = idx + (idx & page_mask);
+        *pRight_idx = left_idx + 1;
+    }
+
+    return left_idx;
+}
+
+static void
+_bubble_up(
+    priq_dev_t  *pDev,
+    long        idx)
+{
+    long                parent_idx = 0l;
+    void                **ppNode_list = pDev->ppNode_list;
+    void                *pCur_node = 0;
+    priq_priority_t     *pCur_node_pri = 0;
+    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
+    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
+
+    pCur_node     = ppNode_list[idx];
+    pCur_node_pri = cb_pri_get(pCur_node);
+
+    for(parent_idx = priq_parent(pDev, idx);
+        (idx > 1) && cb_pri_cmp(cb_pri_get(ppNode_list[parent_idx]), pCur_node_pri);
+        idx = parent_idx, parent_idx = priq_parent(pDev, idx))
+    {
+        ppNode_list[idx] = ppNode_list[parent_idx];
+        priq_pos_set(pDev, ppNode_list[idx], idx);
+    }
+
+    ppNode_list[idx] = pCur_node;
+    priq_pos_set(pDev, pCur_node, idx);
+
+    return;
+}
+
+static long
+_get_child_idx(
+    priq_dev_t  *pDev,
+    long        idx)
+{
+    long                child_idx = LEFT(idx);
+    long                right_idx = RIGHT(idx);
+    void                **ppNode_list = pDev->ppNode_list;
+    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
+    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
+
+    if( pDev->layout == PRIQ_LAYOUT_BHEAP )
+        child_idx = _bheap_child(pDev, idx, &right_idx);
+
+    if( child_idx >= pDev->node_cnt )
+        return 0l;
+
+    // choice left or right child node
+    if( right_idx != child_idx && right_idx < pDev->node_cnt &&
+        cb_pri_cmp(cb_pri_get(ppNode_list[child_idx]), cb_pri_get(ppNode_list[right_idx])) )
+        child_idx = right_idx; // select right child node
+
+    return child_idx;
+}
+
+static void
+_percolate_down(
+    priq_dev_t  *pDev,
+    long        idx)
+{
+    long                child_idx = 0l;
+    void                **ppNode_list = pDev->ppNode_list;
+    void                *pCur_node = 0;
+    priq_priority_t     *pCur_node_pri = 0;
+    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
+    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
+
+    pCur_node     = ppNode_list[idx];
+    pCur_node_pri = cb_pri_get(pCur_node);
+
+    while( (child_idx = _get_child_idx(pDev, idx)) &&
+            cb_pri_cmp(pCur_node_pri, cb_pri_get(ppNode_list[child_idx])) )
+    {
+        ppNode_list[idx] = ppNode_list[child_idx];
+        priq_pos_set(pDev, ppNode_list[idx], idx);
+
+        idx = child_idx;
+    }
+
+    ppNode_list[idx] = pCur_node;
+    priq_pos_set(pDev, pCur_node, idx);
+
+    return;
+}
+
+/**
+ *  the subtrees rooted at the same level are independent,
+ *  so every full level from 'level_start' up is split into contiguous ranges across the workers.
+ */
+static void
+_heapify_levels(
+    heapify_pool_t  *pPool,
+    int             worker_id,
+    long            level_start,
+    long            last_parent)
+{
+    priq_dev_t      *pDev = pPool->pDev;
+
+    for(; level_start > 0; level_start = PARENT(level_start))
+    {
+        long    level_end = LEFT(level_start) - 1;
+        long    level_cnt = 0l, start = 0l, end = 0l, idx = 0l;
+
+        if( level_end > last_parent )
+            level_end = last_parent;
+
+        level_cnt = level_end - level_start + 1;
+        if( level_cnt < PRIQ_PARALLEL_LEVEL_MIN_NODES )
+            break;
+
+        start = level_start + (level_cnt * worker_id) / pPool->worker_num;
+        end   = level_start + (level_cnt * (worker_id + 1)) / pPool->worker_num;
+
+        for(idx = end - 1; idx >= start; idx--)
+            _percolate_down(pDev, idx);
+
+        pthread_barrier_wait(&pPool->barrier);
+    }
+
+    // the remaining upper levels are small, worker 0 finishes them
+    if( worker_id == 0 )
+    {
+        long    idx = 0l;
+
+        for(idx = (level_start) ? LEFT(level_start) - 1 : 0l; idx > 0; idx--)
+        {
+            if( idx <= last_parent )
+                _percolate_down(pDev, idx);
+        }
+    }
+
+    return;
+}
+
+static void*
+_heapify_worker(void *pArg)
+{
+    heapify_worker_t    *pWorker = (heapify_worker_t*)pArg;
+    heapify_pool_t      *pPool = pWorker->pPool;
+    unsigned long       generation = 0ul;
+
+    while( 1 )
+    {
+        long    level_start = 0l, last_parent = 0l;
+
+        priq_mutex_lock(&pPool->mutex);
+        while( !pPool->is_quit && pPool->generation == generation )
+            pthread_cond_wait(&pPool->cond_start, &pPool->mutex);
+
+        if( pPool->is_quit )
+        {
+            priq_mutex_unlock(&pPool->mutex);
+            break;
+        }
+
+        generation  = pPool->generation;
+        level_start = pPool->level_start;
+        last_parent = pPool->last_parent;
+        priq_mutex_unlock(&pPool->mutex);
+
+        _heapify_levels(pPool, pWorker->worker_id, level_start, last_parent);
+    }
+
+    return 0;
+}
+
+static void
+_heapify_pool_destroy(
+    priq_dev_t  *pDev)
+{
+    heapify_pool_t      *pPool = pDev->pHeapify_pool;
+    int                 i = 0;
+
+    if( !pPool )
+        return;
+
+    priq_mutex_lock(&pPool->mutex);
+    pPool->is_quit = 1;
+    pthread_cond_broadcast(&pPool->cond_start);
+    priq_mutex_unlock(&pPool->mutex);
+
+    for(i = 1; i < pPool->worker_num; i++)
+        pthread_join(pPool->pWorkers[i].tid, NULL);
+
+    if( pPool->worker_num > 1 )
+        pthread_barrier_destroy(&pPool->barrier);
+
+    pthread_cond_destroy(&pPool->cond_start);
+    priq_mutex_deinit(&pPool->mutex);
+
+    free(pPool->pWorkers);
+    free(pPool);
+
+    pDev->pHeapify_pool = 0;
+    return;
+}
+
+static priq_err_t
+_heapify_pool_create(
+    priq_dev_t  *pDev)
+{
+    heapify_pool_t      *pPool = 0;
+    int                 i = 0;
+
+    if( !(pPool = malloc(sizeof(heapify_pool_t))) )
+    {
+        err("malloc heapify pool fail, size= %lu\n", sizeof(heapify_pool_t));
+        return PRIQ_ERR_MALLOC_FAIL;
+    }
+
+    memset(pPool, 0x0, sizeof(heapify_pool_t));
+    pPool->pDev = pDev;
+
+    if( !(pPool->pWorkers = malloc(sizeof(heapify_worker_t) * pDev->worker_threads)) )
+    {
+        err("malloc workers fail, size= %lu\n", sizeof(heapify_worker_t) * pDev->worker_threads);
+        free(pPool);
+        return PRIQ_ERR_MALLOC_FAIL;
+    }
+
+    priq_mutex_init(&pPool->mutex);
+    pthread_cond_init(&pPool->cond_start, NULL);
+    pDev->pHeapify_pool = pPool;
+
+    /**
+     *  the barrier needs the final amount of the workers,
+     *  the created workers sleep until the first rebuild bumps 'generation'.
+     */
+    pPool->worker_num = 1;
+    for(i = 1; i < pDev->worker_threads; i++)
+    {
+        pPool->pWorkers[i].pPool     = pPool;
+        pPool->pWorkers[i].worker_id = i;
+
+        if( pthread_create(&pPool->pWorkers[i].tid, NULL, _heapify_worker, &pPool->pWorkers[i]) )
+        {
+            err("create heapify worker %d fail\n", i);
+            break;
+        }
+
+        pPool->worker_num++;
+    }
+
+    if( pPool->worker_num == 1 )
+    {
+        // no worker, rebuild by the caller thread
+        _heapify_pool_destroy(pDev);
+        return PRIQ_ERR_OK;
+    }
+
+    pthread_barrier_init(&pPool->barrier, NULL, pPool->worker_num);
+    return PRIQ_ERR_OK;
+}
+
+static void
+_heapify_parallel(
+    priq_dev_t  *pDev)
+{
+    heapify_pool_t      *pPool = pDev->pHeapify_pool;
+    long                last_parent = PARENT(pDev->node_cnt - 1);
+    long                level_start = 1l, idx = 0l;
+
+    while( LEFT(level_start) <= last_parent )
+        level_start = LEFT(level_start);
+
+    /**
+     *  the deepest level of the parent nodes is usually partial,
+     *  heapify it here if it is too small to split, then split the full levels above it.
+     */
+    if( last_parent - level_start + 1 < PRIQ_PARALLEL_LEVEL_MIN_NODES )
+    {
+        for(idx = last_parent; idx >= level_start; idx--)
+            _percolate_down(pDev, idx);
+
+        level_start = PARENT(level_start);
+    }
+
+    priq_mutex_lock(&pPool->mutex);
+    pPool->level_start = level_start;
+    pPool->last_parent = last_parent;
+    pPool->generation++;
+    pthread_cond_broadcast(&pPool->cond_start);
+    priq_mutex_unlock(&pPool->mutex);
+
+    _heapify_levels(pPool, 0, level_start, last_parent);
+    return;
+}
+
+static void
+_heapify(
+    priq_dev_t  *pDev)
+{
+    long        idx = 0l;
+
+    // the B-heap parent isn't monotonic, walk all nodes from the tail
+    if( pDev->layout == PRIQ_LAYOUT_BHEAP )
+    {
+        for(idx = pDev->node_cnt - 1; idx > 0; idx--)
+            _percolate_down(pDev, idx);
+
+        return;
+    }
+
+    if( pDev->pHeapify_pool &&
+        pDev->node_cnt > PRIQ_PARALLEL_HEAPIFY_MIN_NODES )
+    {
+        _heapify_parallel(pDev);
+        return;
+    }
+
+    // bottom-up rebuild, from the last parent node to the root
+    for(idx = PARENT(pDev->node_cnt - 1); idx > 0; idx--)
+        _percolate_down(pDev, idx);
+
+    return;
+}
+
+static int
+_batch_need_rebuild(
+    priq_dev_t  *pDev,
+    long        num)
+{
+    long        depth = 0l;
+    long        cnt = pDev->node_cnt - 1;
+
+    while( (cnt >> depth) > 1 )
+        depth++;
+
+    // per-node sift costs about 'num * depth', rebuild costs about 'node_cnt'
+    return (num * depth > (pDev->node_cnt - 1) * PRIQ_BATCH_REBUILD_FACTOR);
+}
+
+/**
+ *  sift the nodes appended from 'first_idx' one by one.
+ *  the next nodes and their parents are known in advance,
+ *  so their priorities are prefetched to overlap the cache misses.
+ *  a random key usually stops at its parent, so this is the main cost of a push.
+ */
+static void
+_heap_insert_prefetch(
+    priq_dev_t  *pDev,
+    long        first_idx)
+{
+    void                **ppNode_list = pDev->ppNode_list;
+    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
+    long                idx = 0l;
+
+    for(idx = first_idx; idx < first_idx + PRIQ_PREFETCH_NODES && idx < pDev->node_cnt; idx++)
+    {
+        __builtin_prefetch(cb_pri_get(ppNode_list[idx]));
+
+        // the element 0 isn't a node, the root has no parent
+        if( idx > 1 )
+            __builtin_prefetch(cb_pri_get(ppNode_list[priq_parent(pDev, idx)]));
+    }
+
+    for(idx = first_idx; idx < pDev->node_cnt; idx++)
+    {
+        if( idx + PRIQ_PREFETCH_NODES < pDev->node_cnt )
+        {
+            __builtin_prefetch(cb_pri_get(ppNode_list[idx + PRIQ_PREFETCH_NODES]));
+            __builtin_prefetch(cb_pri_get(ppNode_list[priq_parent(pDev, idx + PRIQ_PREFETCH_NODES)]));
+        }
+
+        _bubble_up(pDev, idx);
+    }
+
+    return;
+}
+
+/**
+ *  append nodes to the heap and sift them, the caller reserves the space.
+ */
+static void
+_heap_insert(
+    priq_dev_t  *pDev,
+    void        **ppNodes,
+    long        num)
+{
+    long        i = 0l, first_idx = 0l;
+
+    first_idx = pDev->node_cnt;
+    for(i = 0; i < num; i++)
+        pDev->ppNode_list[pDev->node_cnt++] = ppNodes[i];
+
+    if( _batch_need_rebuild(pDev, num) )
+    {
+        // leaf nodes never move in heapify, set the positions of them first
+        i = (pDev->layout == PRIQ_LAYOUT_BHEAP) ? first_idx : PARENT(pDev->node_cnt - 1) + 1;
+        for(; i < pDev->node_cnt; i++)
+            priq_pos_set(pDev, pDev->ppNode_list[i], i);
+
+        _heapify(pDev);
+    }
+    else
+    {
+        _heap_insert_prefetch(pDev, first_idx);
+    }
+
+    return;
+}
+
+/**
+ *  merge the buffered nodes into the heap in one batch
+ */
+static void
+_ins_buf_flush(
+    priq_dev_t  *pDev)
+{
+    if( !pDev->ins_buf_cnt )
+        return;
+
+    _heap_insert(pDev, pDev->ppIns_buf, pDev->ins_buf_cnt);
+
+    pDev->ins_buf_cnt = 0;
+    return;
+}
+
+static void
+_change_priority(
+    priq_dev_t          *pDev,
+    priq_priority_t     *pNew_pri,
+    void                *pNode)
+{
+    long                cur_idx = 0l;
+    priq_priority_t     cur_node_pri = {{0}};
+
+    _ins_buf_flush(pDev);
+
+    cur_node_pri = *(pDev->cb_pri_get(pNode));
+
+    pDev->cb_pri_set(pNode, pNew_pri);
+    cur_idx = priq_pos_get(pDev, pNode);
+
+    if( pDev->cb_pri_cmp(&cur_node_pri, pNew_pri) )
+        _bubble_up(pDev, cur_idx);
+    else
+        _percolate_down(pDev, cur_idx);
+
+    priq_trace_op(pDev, PRIQ_OP_CHANGE_PRIORITY, pNode);
+    return;
+}
+
+static unsigned long
+_node_list_size(
+    priq_dev_t  *pDev,
+    long        max_nodes)
+{
+    unsigned long   size = sizeof(void*) * max_nodes;
+
+    if( pDev->huge_page == PRIQ_HUGE_PAGE_EXPLICIT )
+        size = (size + PRIQ_HUGE_PAGE_SIZE - 1) & ~(PRIQ_HUGE_PAGE_SIZE - 1);
+
+    return size;
+}
+
+static void*
+_node_list_map(
+    priq_dev_t      *pDev,
+    unsigned long   size)
+{
+    void        *pMap = MAP_FAILED;
+
+    if( pDev->storage == PRIQ_STORAGE_MMAP_FILE )
+    {
+        if( ftruncate(pDev->fd, size) )
+            return MAP_FAILED;
+
+        return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pDev->fd, 0);
+    }
+
+    #if defined(MAP_HUGETLB)
+    if( pDev->huge_page == PRIQ_HUGE_PAGE_EXPLICIT )
+    {
+        pMap = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if( pMap != MAP_FAILED )
+            return pMap;
+
+        // no reserved huge pages, use the normal pages
+        err("%s", "map huge pages fail, use transparent huge pages\n");
+        pDev->huge_page = PRIQ_HUGE_PAGE_TRANSPARENT;
+    }
+    #endif
+
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+/**
+ *  a B-heap page has to start at a memory page
+ */
+static void*
+_node_list_malloc(
+    priq_dev_t  *pDev,
+    long        max_nodes)
+{
+    void        *pList = 0;
+
+    if( pDev->layout != PRIQ_LAYOUT_BHEAP )
+        return malloc(sizeof(void*) * max_nodes);
+
+    if( posix_memalign(&pList, sizeof(void*) << pDev->page_shift, sizeof(void*) * max_nodes) )
+        return 0;
+
+    return pList;
+}
+
+static priq_err_t
+_node_list_alloc(
+    priq_dev_t  *pDev)
+{
+    void            *pMap = MAP_FAILED;
+    unsigned long   size = 0ul;
+
+    if( pDev->storage == PRIQ_STORAGE_MALLOC )
+    {
+        if( !(pDev->ppNode_list = _node_list_malloc(pDev, pDev->max_nodes)) )
+        {
+            err("malloc node list fail, size= %ld\n", sizeof(void*) * pDev->max_nodes);
+            return PRIQ_ERR_MALLOC_FAIL;
+        }
+
+        memset(pDev->ppNode_list, 0x0, sizeof(void*) * pDev->max_nodes);
+        return PRIQ_ERR_OK;
+    }
+
+    // the pages of a new mapping are zero-filled on demand
+    size = _node_list_size(pDev, pDev->max_nodes);
+    if( (pMap = _node_list_map(pDev, size)) == MAP_FAILED )
+    {
+        err("map node list fail, size= %lu\n", size);
+        return PRIQ_ERR_MALLOC_FAIL;
+    }
+
+    #if defined(MADV_HUGEPAGE)
+    if( pDev->huge_page == PRIQ_HUGE_PAGE_TRANSPARENT )
+        madvise(pMap, size, MADV_HUGEPAGE);
+    #endif
+
+    pDev->ppNode_list = pMap;
+    pDev->map_size    = size;
+    pDev->max_nodes   = size / sizeof(void*);
+    return PRIQ_ERR_OK;
+}
+
+static void
+_node_list_free(
+    priq_dev_t  *pDev)
+{
+    if( pDev->ppNode_list )
+    {
+        if( pDev->storage == PRIQ_STORAGE_MALLOC )
+            free(pDev->ppNode_list);
+        else
+            munmap(pDev->ppNode_list, pDev->map_size);
+    }
+
+    if( pDev->fd >= 0 )
+        close(pDev->fd);
+
+    pDev->ppNode_list = 0;
+    return;
+}
+
+/**
+ *  enlarge the node list to hold 'need_nodes' at least,
+ *  a mapping is remapped by the kernel without copying the nodes.
+ */
+static priq_err_t
+_node_list_grow(
+    priq_dev_t  *pDev,
+    long        need_nodes)
+{
+    long            new_max = pDev->max_nodes;
+    long            limit = (pDev->cb_pos_set64) ? LONG_MAX / (long)sizeof(void*) : (long)INT_MAX;
+    void            *pNew_list = 0;
+    unsigned long   new_size = 0ul;
+
+    if( !pDev->is_growable || need_nodes > limit )
+    {
+        err("queue full %ld/%ld\n", pDev->node_cnt, pDev->max_nodes);
+        return PRIQ_ERR_QUEUE_FULL;
+    }
+
+    while( new_max < need_nodes )
+        new_max = (new_max > limit / 2) ? limit : (new_max << 1);
+
+    if( pDev->storage == PRIQ_STORAGE_MALLOC )
+    {
+        if( pDev->layout == PRIQ_LAYOUT_BHEAP )
+        {
+            // realloc doesn't keep the page alignment
+            if( (pNew_list = _node_list_malloc(pDev, new_max)) )
+            {
+                memcpy(pNew_list, pDev->ppNode_list, sizeof(void*) * pDev->node_cnt);
+                free(pDev->ppNode_list);
+            }
+        }
+        else
+            pNew_list = realloc(pDev->ppNode_list, sizeof(void*) * new_max);
+
+        if( !pNew_list )
+        {
+            err("realloc node list fail, size= %ld\n", sizeof(void*) * new_max);
+            return PRIQ_ERR_MALLOC_FAIL;
+        }
+
+        pDev->ppNode_list = pNew_list;
+        pDev->max_nodes   = new_max;
+        return PRIQ_ERR_OK;
+    }
+
+    new_size = _node_list_size(pDev, new_max);
+
+    if( pDev->storage == PRIQ_STORAGE_MMAP_FILE &&
+        ftruncate(pDev->fd, new_size) )
+    {
+        err("extend node list file fail, size= %lu\n", new_size);
+        return PRIQ_ERR_IO_FAIL;
+    }
+
+    #if defined(MREMAP_MAYMOVE)
+    pNew_list = mremap(pDev->ppNode_list, pDev->map_size, new_size, MREMAP_MAYMOVE);
+    #else
+    pNew_list = MAP_FAILED;
+    #endif
+
+    if( pNew_list == MAP_FAILED )
+    {
+        /**
+         *  no remap support (e.g. some huge page mappings), map a new one.
+         *  a file mapping shares the same pages, an anonymous one is copied.
+         */
+        if( (pNew_list = _node_list_map(pDev, new_size)) == MAP_FAILED )
+        {
+            err("remap node list fail, size= %lu\n", new_size);
+            return PRIQ_ERR_MALLOC_FAIL;
+        }
+
+        if( pDev->storage != PRIQ_STORAGE_MMAP_FILE )
+            memcpy(pNew_list, pDev->ppNode_list, sizeof(void*) * pDev->node_cnt);
+
+        munmap(pDev->ppNode_list, pDev->map_size);
+    }
+
+    #if defined(MADV_HUGEPAGE)
+    if( pDev->huge_page == PRIQ_HUGE_PAGE_TRANSPARENT )
+        madvise(pNew_list, new_size, MADV_HUGEPAGE);
+    #endif
+
+    pDev->ppNode_list = pNew_list;
+    pDev->map_size    = new_size;
+    pDev->max_nodes   = new_size / sizeof(void*);
+    return PRIQ_ERR_OK;
+}
+
+static priq_err_t
+_push(
+    priq_dev_t  *pDev,
+    void        *pNode)
+{
+    priq_err_t  rval = PRIQ_ERR_OK;
+    long        idx = 0l;
+
+    // buffered nodes are merged into the node list later, keep the space
+    if( pDev->node_cnt + pDev->ins_buf_cnt >= pDev->max_nodes &&
+        (rval = _node_list_grow(pDev, pDev->node_cnt + pDev->ins_buf_cnt + 1)) )
+        return rval;
+
+    if( pDev->ins_buf_size )
+    {
+        if( pDev->ins_buf_cnt == pDev->ins_buf_size )
+            _ins_buf_flush(pDev);
+
+        pDev->ppIns_buf[pDev->ins_buf_cnt++] = pNode;
+    }
+    else
+    {
+        idx = pDev->node_cnt++;
+        pDev->ppNode_list[idx] = pNode;
+
+        _bubble_up(pDev, idx);
+    }
+
+    priq_trace_op(pDev, PRIQ_OP_PUSH, pNode);
 
+    priq_update_remain(pDev);
+    return PRIQ_ERR_OK;
+}
 
-#ifndef MEMBER_OFFSET
-    #define MEMBER_OFFSET(type, member)     (unsigned long)&(((type *)0)->member)
-#endif
+static priq_err_t
+_push_batch(
+    priq_dev_t  *pDev,
+    void        **ppNodes,
+    long        num)
+{
+    priq_err_t  rval = PRIQ_ERR_OK;
+    long        i = 0l;
 
-#ifndef STRUCTURE_POINTER
-    #define STRUCTURE_POINTER(type, ptr, member)    (type*)((unsigned long)ptr - MEMBER_OFFSET(type, member))
-#endif
+    if( pDev->node_cnt + pDev->ins_buf_cnt + num > pDev->max_nodes &&
+        (rval = _node_list_grow(pDev, pDev->node_cnt + pDev->ins_buf_cnt + num)) )
+        return rval;
 
-#define priq_verify_handle(handle, err_code)            \
-            do{ if(handle==NULL){                       \
-                err("%s", "input Null pointer !!\n");   \
-                return err_code;}                       \
-            }while(0)
+    // a batch is already amortized, it goes to the heap directly
+    _heap_insert(pDev, ppNodes, num);
 
+    if( pDev->cb_trace )
+    {
+        for(i = 0; i < num; i++)
+            priq_trace_op(pDev, PRIQ_OP_PUSH, ppNodes[i]);
+    }
 
+    priq_update_remain(pDev);
+    return PRIQ_ERR_OK;
+}
 
-#define priq_mutex_init(pMtx)               pthread_mutex_init(pMtx, NULL)
-#define priq_mutex_deinit(pMtx)             pthread_mutex_destroy(pMtx)
-#define priq_mutex_lock(pMtx)               pthread_mutex_lock(pMtx)
-#define priq_mutex_unlock(pMtx)             pthread_mutex_unlock(pMtx)
-//=============================================================================
-//                  Structure Definition
-//=============================================================================
-typedef struct priq_dev
+static priq_err_t
+_pop(
+    priq_dev_t  *pDev,
+    void        **ppNode)
 {
-    priq_t              hPriq;
-
-    pthread_mutex_t     mutex;
+    *ppNode = NULL;
 
-    int                 node_cnt;
-    long                max_nodes;
+    _ins_buf_flush(pDev);
 
-    CB_PRIORITY_GET     cb_pri_get;
-    CB_PRIORITY_SET     cb_pri_set;
-    CB_PRIORITY_CMP     cb_pri_cmp;
+    if( pDev->node_cnt == 1 )
+    {
+        err("%s", "queue is empty \n");
+        return PRIQ_ERR_QUEUE_EMPTY;
+    }
 
-    CB_POSITION_GET     cb_pos_get;
-    CB_POSITION_SET     cb_pos_set;
+    *ppNode = pDev->ppNode_list[1];
 
+    pDev->ppNode_list[1] = pDev->ppNode_list[--pDev->node_cnt];
+    _percolate_down(pDev, 1);
 
-    void                **ppNode_list;
+    priq_trace_op(pDev, PRIQ_OP_POP, *ppNode);
 
-} priq_dev_t;
-//=============================================================================
-//                  Global Data Definition
-//=============================================================================
+    priq_update_remain(pDev);
+    return PRIQ_ERR_OK;
+}
 
-//=============================================================================
-//                  Private Function Definition
-//=============================================================================
 static void
-_bubble_up(
+_remove(
     priq_dev_t  *pDev,
-    long        idx)
+    void        *pNode)
 {
-    long                parent_idx = 0l;
-    void                **ppNode_list = pDev->ppNode_list;
-    void                *pCur_node = 0;
-    priq_priority_t     *pCur_node_pri = 0;
-    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
-    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
-    CB_POSITION_SET     cb_pos_set = pDev->cb_pos_set;
+    long        cur_idx = 0l;
 
-    pCur_node     = ppNode_list[idx];
-    pCur_node_pri = cb_pri_get(pCur_node);
+    _ins_buf_flush(pDev);
 
-    for(parent_idx = PARENT(idx);
-        (idx > 1) && cb_pri_cmp(cb_pri_get(ppNode_list[parent_idx]), pCur_node_pri);
-        idx = parent_idx, parent_idx = PARENT(idx))
-    {
-        ppNode_list[idx] = ppNode_list[parent_idx];
-        cb_pos_set(ppNode_list[idx], (int)idx);
-    }
+    cur_idx = priq_pos_get(pDev, pNode);
 
-    ppNode_list[idx] = pCur_node;
-    cb_pos_set(pCur_node, (int)idx);
+    pDev->ppNode_list[cur_idx] = pDev->ppNode_list[--pDev->node_cnt];
+
+    if( pDev->cb_pri_cmp(pDev->cb_pri_get(pNode), pDev->cb_pri_get(pDev->ppNode_list[cur_idx])))
+        _bubble_up(pDev, cur_idx);
+    else
+        _percolate_down(pDev, cur_idx);
 
+    priq_trace_op(pDev, PRIQ_OP_REMOVE, pNode);
+
+    priq_update_remain(pDev);
     return;
 }
 
-static long
-_get_child_idx(
-    priq_dev_t  *pDev,
-    long        idx)
+/**
+ *  apply all published requests, the caller holds the mutex.
+ *  pushes go in as one batch, then priority changes, then pops from the top.
+ */
+static void
+_fc_combine(
+    priq_dev_t  *pDev)
 {
-    long                child_idx = LEFT(idx);
-    void                **ppNode_list = pDev->ppNode_list;
-    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
-    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
+    fc_slot_t   *pSlots = pDev->pFc_slots;
+    int         i = 0, push_num = 0;
+
+    /**
+     *  the owners poll 'state' concurrently, so every access of it is atomic.
+     *  only the combiner moves a slot from PENDING to DONE,
+     *  the re-checks of its own COMBINING mark don't need ordering.
+     */
+    // take a snapshot of the published requests
+    for(i = 0; i < pDev->fc_slot_num; i++)
+    {
+        if( __atomic_load_n(&pSlots[i].state, __ATOMIC_ACQUIRE) != FC_SLOT_PENDING )
+            continue;
 
-    if( child_idx >= pDev->node_cnt )
-        return 0l;
+        __atomic_store_n(&pSlots[i].state, FC_SLOT_COMBINING, __ATOMIC_RELAXED);
+        pSlots[i].rval  = PRIQ_ERR_OK;
 
-    // choice left or right child node
-    if( (child_idx + 1) < pDev->node_cnt &&
-        cb_pri_cmp(cb_pri_get(ppNode_list[child_idx]), cb_pri_get(ppNode_list[child_idx+1])) )
-        child_idx++; // select right child node
+        if( pSlots[i].op == PRIQ_OP_PUSH )
+            pDev->ppFc_push_nodes[push_num++] = pSlots[i].pNode;
+    }
 
-    return child_idx;
+    // not enough space for all of them, push one by one to fill the queue
+    if( push_num && _push_batch(pDev, pDev->ppFc_push_nodes, push_num) )
+    {
+        for(i = 0; i < pDev->fc_slot_num; i++)
+        {
+            if( __atomic_load_n(&pSlots[i].state, __ATOMIC_RELAXED) == FC_SLOT_COMBINING &&
+                pSlots[i].op == PRIQ_OP_PUSH )
+                pSlots[i].rval = _push(pDev, pSlots[i].pNode);
+        }
+    }
+
+    for(i = 0; i < pDev->fc_slot_num; i++)
+    {
+        if( __atomic_load_n(&pSlots[i].state, __ATOMIC_RELAXED) == FC_SLOT_COMBINING &&
+            pSlots[i].op == PRIQ_OP_CHANGE_PRIORITY )
+            _change_priority(pDev, pSlots[i].pPri, pSlots[i].pNode);
+    }
+
+    for(i = 0; i < pDev->fc_slot_num; i++)
+    {
+        if( __atomic_load_n(&pSlots[i].state, __ATOMIC_RELAXED) != FC_SLOT_COMBINING )
+            continue;
+
+        if( pSlots[i].op == PRIQ_OP_POP )
+            pSlots[i].rval = _pop(pDev, &pSlots[i].pNode);
+
+        __atomic_store_n(&pSlots[i].state, FC_SLOT_DONE, __ATOMIC_RELEASE);
+    }
+
+    return;
 }
 
-static void
-_percolate_down(
-    priq_dev_t  *pDev,
-    long        idx)
+/**
+ *  publish a request and wait until a combiner (maybe this thread) applies it
+ */
+static priq_err_t
+_fc_submit(
+    priq_dev_t          *pDev,
+    priq_op_t           op,
+    void                *pNode,
+    priq_priority_t     *pPri,
+    void                **ppNode)
 {
-    long                child_idx = 0l;
-    void                **ppNode_list = pDev->ppNode_list;
-    void                *pCur_node = 0;
-    priq_priority_t     *pCur_node_pri = 0;
-    CB_PRIORITY_GET     cb_pri_get = pDev->cb_pri_get;
-    CB_PRIORITY_CMP     cb_pri_cmp = pDev->cb_pri_cmp;
-    CB_POSITION_SET     cb_pos_set = pDev->cb_pos_set;
+    priq_err_t      rval = PRIQ_ERR_OK;
+    fc_slot_t       *pSlot = 0;
+    int             idx = 0, retry = 0;
 
-    pCur_node     = ppNode_list[idx];
-    pCur_node_pri = cb_pri_get(pCur_node);
+    if( g_fc_slot_hint < 0 )
+        g_fc_slot_hint = __atomic_fetch_add(&g_fc_thread_cnt, 1, __ATOMIC_RELAXED) & 0x7FFFFFFF;
 
-    while( (child_idx = _get_child_idx(pDev, idx)) &&
-            cb_pri_cmp(pCur_node_pri, cb_pri_get(ppNode_list[child_idx])) )
+    // claim a slot, more threads than slots share them
+    for(idx = g_fc_slot_hint % pDev->fc_slot_num; ; idx = (idx + 1) % pDev->fc_slot_num)
     {
-        ppNode_list[idx] = ppNode_list[child_idx];
-        cb_pos_set(ppNode_list[idx], (int)idx);
+        int     expected = FC_SLOT_FREE;
 
-        idx = child_idx;
+        if( __atomic_compare_exchange_n(&pDev->pFc_slots[idx].state, &expected, FC_SLOT_BUSY,
+                                        0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+            break;
+
+        if( ++retry == pDev->fc_slot_num )
+        {
+            retry = 0;
+            sched_yield();
+        }
     }
 
-    ppNode_list[idx] = pCur_node;
-    cb_pos_set(pCur_node, (int)idx);
+    pSlot = &pDev->pFc_slots[idx];
+    pSlot->op    = op;
+    pSlot->pNode = pNode;
+    pSlot->pPri  = pPri;
+    __atomic_store_n(&pSlot->state, FC_SLOT_PENDING, __ATOMIC_RELEASE);
 
-    return;
+    while( __atomic_load_n(&pSlot->state, __ATOMIC_ACQUIRE) != FC_SLOT_DONE )
+    {
+        if( !pthread_mutex_trylock(&pDev->mutex) )
+        {
+            _fc_combine(pDev);
+            priq_mutex_unlock(&pDev->mutex);
+            continue;
+        }
+
+        sched_yield();
+    }
+
+    rval = pSlot->rval;
+    if( ppNode )
+        *ppNode = pSlot->pNode;
+
+    __atomic_store_n(&pSlot->state, FC_SLOT_FREE, __ATOMIC_RELEASE);
+
+    return rval;
 }
 //=============================================================================
 //                  Public Function Definition
@@ -195,7 +1216,8 @@ priq_create(
         }
 
         if( !pInit_info->cb_pri_get || !pInit_info->cb_pri_set || !pInit_info->cb_pri_cmp ||
-            !pInit_info->cb_pos_get || !pInit_info->cb_pos_set )
+            ((!pInit_info->cb_pos_get || !pInit_info->cb_pos_set) &&
+             (!pInit_info->cb_pos_get64 || !pInit_info->cb_pos_set64)) )
         {
             err("%s", "callback can't be null \n");
             rval = PRIQ_ERR_INVALID_PARAM;
@@ -211,6 +1233,7 @@ priq_create(
         }
 
         memset(pDev, 0x0, sizeof(priq_dev_t));
+        pDev->fd = -1;
 
         if( priq_mutex_init(&pDev->mutex) )
         {
@@ -220,24 +1243,117 @@ priq_create(
         }
 
         // element 0 isn't used for mapping indxe and count.
-        pDev->max_nodes = pInit_info->amount_nodes + 1;
+        pDev->max_nodes = (pInit_info->amount_nodes64 > 0)
+                        ? (long)pInit_info->amount_nodes64 + 1 : (long)pInit_info->amount_nodes + 1;
         pDev->node_cnt  = 1;
 
+        // the byte size of the node list has to fit in a long
+        if( pInit_info->amount_nodes64 >= LONG_MAX / (long)sizeof(void*) )
+        {
+            err("amount nodes %lld is too large\n", pInit_info->amount_nodes64);
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
         pDev->cb_pri_get = pInit_info->cb_pri_get;
         pDev->cb_pri_set = pInit_info->cb_pri_set;
         pDev->cb_pri_cmp = pInit_info->cb_pri_cmp;
         pDev->cb_pos_get = pInit_info->cb_pos_get;
         pDev->cb_pos_set = pInit_info->cb_pos_set;
 
-        if( !(pDev->ppNode_list = malloc(sizeof(void*) * pDev->max_nodes)) )
+        if( pInit_info->cb_pos_get64 && pInit_info->cb_pos_set64 )
         {
-            err("malloc node list fail, size= %d\n", sizeof(void*) * pDev->max_nodes);
-            rval = PRIQ_ERR_MALLOC_FAIL;
+            pDev->cb_pos_get64 = pInit_info->cb_pos_get64;
+            pDev->cb_pos_set64 = pInit_info->cb_pos_set64;
+        }
+
+        // only the installed 64-bit pair can keep the positions over INT_MAX
+        if( pDev->max_nodes > INT_MAX && !pDev->cb_pos_set64 )
+        {
+            err("%s", "more than 2^31 nodes need the 64-bit position callbacks\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
             break;
         }
-        memset(pDev->ppNode_list, 0x0, sizeof(void*) * pDev->max_nodes);
 
-        pDev->hPriq.remain_num = pDev->node_cnt - 1;
+        pDev->worker_threads = (pInit_info->worker_threads > 1) ? pInit_info->worker_threads : 1;
+
+        pDev->cb_trace    = pInit_info->cb_trace;
+        pDev->pTrace_priv = pInit_info->pTrace_priv;
+
+        if( pInit_info->fc_slots > 0 )
+        {
+            pDev->fc_slot_num = pInit_info->fc_slots;
+
+            if( posix_memalign((void**)&pDev->pFc_slots, PRIQ_CACHE_LINE_SIZE, sizeof(fc_slot_t) * pDev->fc_slot_num) ||
+                !(pDev->ppFc_push_nodes = malloc(sizeof(void*) * pDev->fc_slot_num)) )
+            {
+                err("malloc combining slots fail, num= %d\n", pDev->fc_slot_num);
+                rval = PRIQ_ERR_MALLOC_FAIL;
+                break;
+            }
+            memset(pDev->pFc_slots, 0x0, sizeof(fc_slot_t) * pDev->fc_slot_num);
+        }
+
+        pDev->storage     = pInit_info->storage;
+        pDev->huge_page   = pInit_info->huge_page;
+        pDev->is_growable = pInit_info->is_growable;
+
+        if( pInit_info->insert_buf_nodes > 0 )
+        {
+            pDev->ins_buf_size = pInit_info->insert_buf_nodes;
+
+            if( !(pDev->ppIns_buf = malloc(sizeof(void*) * pDev->ins_buf_size)) )
+            {
+                err("malloc insertion buffer fail, size= %lu\n", sizeof(void*) * pDev->ins_buf_size);
+                rval = PRIQ_ERR_MALLOC_FAIL;
+                break;
+            }
+        }
+
+        pDev->layout = pInit_info->layout;
+        if( pDev->layout == PRIQ_LAYOUT_BHEAP )
+        {
+            long    page_nodes = pInit_info->page_nodes;
+
+            if( page_nodes <= 0 )
+                page_nodes = sysconf(_SC_PAGESIZE) / sizeof(void*);
+
+            if( page_nodes < 8 || (page_nodes & (page_nodes - 1)) )
+            {
+                err("page nodes %ld must be a power of 2 (>= 8)\n", page_nodes);
+                rval = PRIQ_ERR_INVALID_PARAM;
+                break;
+            }
+
+            pDev->page_mask = page_nodes - 1;
+            while( (1l << pDev->page_shift) < page_nodes )
+                pDev->page_shift++;
+        }
+
+        if( pDev->storage == PRIQ_STORAGE_MMAP_FILE )
+        {
+            if( !pInit_info->pStorage_path ||
+                (pDev->fd = open(pInit_info->pStorage_path, O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0 )
+            {
+                err("%s", "open node list file fail\n");
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            // explicit huge pages are only for the anonymous mapping
+            if( pDev->huge_page == PRIQ_HUGE_PAGE_EXPLICIT )
+                pDev->huge_page = PRIQ_HUGE_PAGE_NONE;
+        }
+
+        if( (rval = _node_list_alloc(pDev)) )
+            break;
+
+        // the B-heap layout is always rebuilt by the caller thread
+        if( pDev->worker_threads > 1 && pDev->layout != PRIQ_LAYOUT_BHEAP &&
+            (rval = _heapify_pool_create(pDev)) )
+            break;
+
+        priq_update_remain(pDev);
         //------------------------
         *ppHPriq = &pDev->hPriq;
 
@@ -274,8 +1390,18 @@ priq_destroy(priq_t  **ppHPriq)
         *ppHPriq = 0;
         mutex = pDev->mutex;
 
-        if( pDev->ppNode_list )
-            free(pDev->ppNode_list);
+        _heapify_pool_destroy(pDev);
+
+        _node_list_free(pDev);
+
+        if( pDev->pFc_slots )
+            free(pDev->pFc_slots);
+
+        if( pDev->ppFc_push_nodes )
+            free(pDev->ppFc_push_nodes);
+
+        if( pDev->ppIns_buf )
+            free(pDev->ppIns_buf);
 
         free(pDev);
 
@@ -298,26 +1424,36 @@ priq_node_push(
     priq_verify_handle(pHPriq, PRIQ_ERR_INVALID_PARAM);
     priq_verify_handle(pNode, PRIQ_ERR_INVALID_PARAM);
 
+    if( pDev->fc_slot_num )
+        return _fc_submit(pDev, PRIQ_OP_PUSH, pNode, 0, 0);
+
     priq_mutex_lock(&pDev->mutex);
 
-    do {
-        int     idx = 0;
+    rval = _push(pDev, pNode);
 
-        if( pDev->node_cnt >= pDev->max_nodes )
-        {
-            err("queue full %d/%d\n", pDev->node_cnt, pDev->max_nodes);
-            rval = PRIQ_ERR_QUEUE_FULL;
-            break;
-        }
+    priq_mutex_unlock(&pDev->mutex);
 
-        idx = pDev->node_cnt++;
-        pDev->ppNode_list[idx] = pNode;
+    return rval;
+}
 
-        _bubble_up(pDev, idx);
+priq_err_t
+priq_node_push_batch(
+    priq_t      *pHPriq,
+    void        **ppNodes,
+    long        num)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    priq_dev_t      *pDev = STRUCTURE_POINTER(priq_dev_t, pHPriq, hPriq);
+
+    priq_verify_handle(pHPriq, PRIQ_ERR_INVALID_PARAM);
+    priq_verify_handle(ppNodes, PRIQ_ERR_INVALID_PARAM);
 
-        pDev->hPriq.remain_num = pDev->node_cnt - 1;
+    if( num <= 0 )
+        return PRIQ_ERR_OK;
 
-    } while(0);
+    priq_mutex_lock(&pDev->mutex);
+
+    rval = _push_batch(pDev, ppNodes, num);
 
     priq_mutex_unlock(&pDev->mutex);
 
@@ -335,10 +1471,38 @@ priq_node_pop(
     priq_verify_handle(pHPriq, PRIQ_ERR_INVALID_PARAM);
     priq_verify_handle(ppNode, PRIQ_ERR_INVALID_PARAM);
 
+    if( pDev->fc_slot_num )
+        return _fc_submit(pDev, PRIQ_OP_POP, 0, 0, ppNode);
+
+    priq_mutex_lock(&pDev->mutex);
+
+    rval = _pop(pDev, ppNode);
+
+    priq_mutex_unlock(&pDev->mutex);
+
+    return rval;
+}
+
+priq_err_t
+priq_node_replace_top(
+    priq_t      *pHPriq,
+    void        *pNew_node,
+    void        **ppOld_node)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    priq_dev_t      *pDev = STRUCTURE_POINTER(priq_dev_t, pHPriq, hPriq);
+
+    priq_verify_handle(pHPriq, PRIQ_ERR_INVALID_PARAM);
+    priq_verify_handle(pNew_node, PRIQ_ERR_INVALID_PARAM);
+    priq_verify_handle(ppOld_node, PRIQ_ERR_INVALID_PARAM);
+
     priq_mutex_lock(&pDev->mutex);
 
     do {
-        *ppNode = NULL;
+        *ppOld_node = NULL;
+
+        // the top has to be the first of all nodes
+        _ins_buf_flush(pDev);
 
         if( pDev->node_cnt == 1 )
         {
@@ -347,12 +1511,22 @@ priq_node_pop(
             break;
         }
 
-        *ppNode = pDev->ppNode_list[1];
+        *ppOld_node = pDev->ppNode_list[1];
 
-        pDev->ppNode_list[1] = pDev->ppNode_list[--pDev->node_cnt];
+        // pop + push with only one sift
+        pDev->ppNode_list[1] = pNew_node;
         _percolate_down(pDev, 1);
 
-        pDev->hPriq.remain_num = pDev->node_cnt - 1;
+        if( *ppOld_node == pNew_node )
+        {
+            // the key of the top node was changed in place
+            priq_trace_op(pDev, PRIQ_OP_CHANGE_PRIORITY, pNew_node);
+        }
+        else
+        {
+            priq_trace_op(pDev, PRIQ_OP_POP, *ppOld_node);
+            priq_trace_op(pDev, PRIQ_OP_PUSH, pNew_node);
+        }
 
     } while(0);
 
@@ -374,21 +1548,63 @@ priq_node_change_priority(
     priq_verify_handle(pNew_pri, PRIQ_ERR_INVALID_PARAM);
     priq_verify_handle(pNode, PRIQ_ERR_INVALID_PARAM);
 
+    if( pDev->fc_slot_num )
+        return _fc_submit(pDev, PRIQ_OP_CHANGE_PRIORITY, pNode, pNew_pri, 0);
+
+    priq_mutex_lock(&pDev->mutex);
+
+    do {
+        _change_priority(pDev, pNew_pri, pNode);
+    } while(0);
+
+    priq_mutex_unlock(&pDev->mutex);
+
+    return rval;
+}
+
+priq_err_t
+priq_node_change_priority_batch(
+    priq_t              *pHPriq,
+    void                **ppNodes,
+    priq_priority_t     *pNew_pris,
+    long                num)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    priq_dev_t      *pDev = STRUCTURE_POINTER(priq_dev_t, pHPriq, hPriq);
+
+    priq_verify_handle(pHPriq, PRIQ_ERR_INVALID_PARAM);
+    priq_verify_handle(ppNodes, PRIQ_ERR_INVALID_PARAM);
+    priq_verify_handle(pNew_pris, PRIQ_ERR_INVALID_PARAM);
+
+    if( num <= 0 )
+        return PRIQ_ERR_OK;
+
     priq_mutex_lock(&pDev->mutex);
 
     do {
-        int                 cur_idx = 0;
-        priq_priority_t     cur_node_pri = {{0}};
+        long    i = 0l;
+
+        if( !_batch_need_rebuild(pDev, num) )
+        {
+            for(i = 0; i < num; i++)
+                _change_priority(pDev, &pNew_pris[i], ppNodes[i]);
+
+            break;
+        }
 
-        cur_node_pri = *(pDev->cb_pri_get(pNode));
+        // large batch: update all priorities, then rebuild in one linear pass
+        _ins_buf_flush(pDev);
 
-        pDev->cb_pri_set(pNode, pNew_pri);
-        cur_idx = pDev->cb_pos_get(pNode);
+        for(i = 0; i < num; i++)
+            pDev->cb_pri_set(ppNodes[i], &pNew_pris[i]);
 
-        if( pDev->cb_pri_cmp(&cur_node_pri, pNew_pri) )
-            _bubble_up(pDev, cur_idx);
-        else
-            _percolate_down(pDev, cur_idx);
+        _heapify(pDev);
+
+        if( pDev->cb_trace )
+        {
+            for(i = 0; i < num; i++)
+                priq_trace_op(pDev, PRIQ_OP_CHANGE_PRIORITY, ppNodes[i]);
+        }
 
     } while(0);
 
@@ -413,6 +1629,8 @@ priq_node_peek(
     do {
         *ppNode = NULL;
 
+        _ins_buf_flush(pDev);
+
         if( pDev->node_cnt == 1 )
         {
             err("%s", "queue is empty \n");
@@ -443,16 +1661,7 @@ priq_node_remove(
     priq_mutex_lock(&pDev->mutex);
 
     do {
-        long         cur_idx = 0l;
-
-        cur_idx = (long)pDev->cb_pos_get(pNode);
-        pDev->ppNode_list[cur_idx] = pDev->ppNode_list[--pDev->node_cnt];
-
-        if( pDev->cb_pri_cmp(pDev->cb_pri_get(pNode), pDev->cb_pri_get(pDev->ppNode_list[cur_idx])))
-            _bubble_up(pDev, cur_idx);
-        else
-            _percolate_down(pDev, cur_idx);
-
+        _remove(pDev, pNode);
     } while(0);
 
     priq_mutex_unlock(&pDev->mutex);
@@ -518,6 +1727,8 @@ priq_print(
         priq_dev_t          dup_dev = {{0}};
         void                **ppNode_list = 0, *pNode = 0;
 
+        _ins_buf_flush(pDev);
+
         if( pDev->node_cnt == 1 )
         {
             err("%s", "queue is empty \n");
@@ -525,6 +1736,9 @@ priq_print(
         }
 
         dup_dev.max_nodes  = pDev->max_nodes;
+        dup_dev.layout     = pDev->layout;
+        dup_dev.page_shift = pDev->page_shift;
+        dup_dev.page_mask  = pDev->page_mask;
         dup_dev.node_cnt   = pDev->node_cnt;
         dup_dev.cb_pri_get = pDev->cb_pri_get;
         dup_dev.cb_pri_cmp = pDev->cb_pri_cmp;
@@ -535,7 +1749,7 @@ priq_print(
 
         if( !(ppNode_list = malloc(sizeof(void*) * (dup_dev.node_cnt + 1))) )
         {
-            err("malloc node list fail, size= %d\n", sizeof(void*) * (dup_dev.node_cnt + 1));
+            err("malloc node list fail, size= %ld\n", sizeof(void*) * (dup_dev.node_cnt + 1));
             break;
         }
 
@@ -31,9 +31,42 @@ typedef enum priq_err
     PRIQ_ERR_INVALID_PARAM,
     PRIQ_ERR_QUEUE_FULL,
     PRIQ_ERR_QUEUE_EMPTY,
+    PRIQ_ERR_IO_FAIL,
     PRIQ_ERR_UNKNOWN,
 } priq_err_t;
 
+/**
+ *  storage of the internal node list
+ */
+typedef enum priq_storage
+{
+    PRIQ_STORAGE_MALLOC         = 0,
+    PRIQ_STORAGE_MMAP_ANON,         // anonymous mmap, grows by mremap
+    PRIQ_STORAGE_MMAP_FILE,         // shared mmap of pStorage_path (paged to the file)
+
+} priq_storage_t;
+
+/**
+ *  huge pages of a mmap node list
+ */
+typedef enum priq_huge_page
+{
+    PRIQ_HUGE_PAGE_NONE         = 0,
+    PRIQ_HUGE_PAGE_TRANSPARENT,     // madvise(MADV_HUGEPAGE)
+    PRIQ_HUGE_PAGE_EXPLICIT,        // MAP_HUGETLB, anonymous mapping only
+
+} priq_huge_page_t;
+
+/**
+ *  index mapping of the node list
+ */
+typedef enum priq_layout
+{
+    PRIQ_LAYOUT_BINARY          = 0,    // classic, children of x are 2x and 2x+1
+    PRIQ_LAYOUT_BHEAP,                  // subtrees packed in page-sized blocks
+
+} priq_layout_t;
+
 /**
  *  priority type
  */
@@ -62,6 +95,29 @@ typedef int (*CB_PRIORITY_CMP)(priq_priority_t *pNext_node, priq_priority_t *pCu
 typedef int (*CB_POSITION_GET)(void *pNode);
 typedef void (*CB_POSITION_SET)(void *pNode, int index);
 
+/** 64-bit version of the position callbacks, for more than 2^31 nodes */
+typedef long long (*CB_POSITION_GET64)(void *pNode);
+typedef void (*CB_POSITION_SET64)(void *pNode, long long index);
+
+
+/**
+ *  operation type of the trace callback
+ */
+typedef enum priq_op
+{
+    PRIQ_OP_PUSH        = 0,
+    PRIQ_OP_POP,
+    PRIQ_OP_CHANGE_PRIORITY,
+    PRIQ_OP_REMOVE,
+
+} priq_op_t;
+
+/**
+ *  trace callback, called under the queue lock after an operation is applied,
+ *  pPri is the priority of pNode at that moment.
+ */
+typedef void (*CB_TRACE_OP)(void *pTrace_priv, priq_op_t op, void *pNode, priq_priority_t *pPri);
+
 
 /** debug callback function to print a entry */
 typedef void (*CB_PRINT_ENTRY)(void *pOut_dev, void *pNode, void *pExtra);
@@ -78,6 +134,7 @@ typedef void (*CB_PRINT_ENTRY)(void *pOut_dev, void *pNode, void *pExtra);
 typedef struct priq_init_info
 {
     int         amount_nodes;
+    long long   amount_nodes64;     // > 0 => used instead of amount_nodes
 
     CB_PRIORITY_GET     cb_pri_get;
     CB_PRIORITY_SET     cb_pri_set;
@@ -86,6 +143,57 @@ typedef struct priq_init_info
     CB_POSITION_GET     cb_pos_get;
     CB_POSITION_SET     cb_pos_set;
 
+    // set both to use 64-bit positions, then cb_pos_get/cb_pos_set can be NULL
+    CB_POSITION_GET64   cb_pos_get64;
+    CB_POSITION_SET64   cb_pos_set64;
+
+    /**
+     *  threads used to rebuild the whole heap (bulk push/priority update),
+     *  0 or 1 => rebuild in the caller thread.
+     *  the workers are created by priq_create() and kept until priq_destroy().
+     *  with more threads, the priority/position callbacks are called
+     *  concurrently on different nodes.
+     */
+    int         worker_threads;
+
+    /**
+     *  optional operation trace (e.g. priq_trace_record() of priq_trace.h)
+     */
+    CB_TRACE_OP         cb_trace;
+    void                *pTrace_priv;
+
+    /**
+     *  flat combining: the number of publication slots (about the number of
+     *  concurrent threads), 0 => every call takes the mutex itself.
+     *  push/pop/change_priority are published to a slot and the thread
+     *  holding the mutex applies all pending requests at once.
+     */
+    int         fc_slots;
+
+    /**
+     *  node list storage, a full queue is enlarged (x2) when is_growable
+     */
+    priq_storage_t      storage;
+    const char          *pStorage_path;
+    priq_huge_page_t    huge_page;
+    int                 is_growable;
+
+    /**
+     *  B-heap layout: a sift touches about log(n)/log(page_nodes) pages,
+     *  page_nodes is a power of 2 (0 => system page size / sizeof(void*)).
+     *  a rebuild of this layout always runs in the caller thread.
+     */
+    priq_layout_t       layout;
+    long                page_nodes;
+
+    /**
+     *  insertion buffer: pushes are only appended to a small buffer (e.g. 64 nodes)
+     *  and merged into the heap in one batch when it is full or before any
+     *  other operation, the merge prefetches the nodes to sift.
+     *  it helps when the nodes are scattered in memory. 0 => disable.
+     */
+    int                 insert_buf_nodes;
+
 } priq_init_info_t;
 
 /**
@@ -93,7 +201,7 @@ typedef struct priq_init_info
  */
 typedef struct priq
 {
-    int         remain_num;
+    long long   remain_num;
 } priq_t;
 //=============================================================================
 //                  Global Data Definition
@@ -122,12 +230,34 @@ priq_node_push(
     void        *pNode);
 
 
+/**
+ *  push 'num' nodes under one lock (all or nothing),
+ *  a large batch is appended and rebuilt bottom-up.
+ */
+priq_err_t
+priq_node_push_batch(
+    priq_t      *pHPriq,
+    void        **ppNodes,
+    long        num);
+
+
 priq_err_t
 priq_node_pop(
     priq_t      *pHPriq,
     void        **ppNode);
 
 
+/**
+ *  pop the top node and push pNew_node with one sift,
+ *  pNew_node can be the top node itself after its priority was changed.
+ */
+priq_err_t
+priq_node_replace_top(
+    priq_t      *pHPriq,
+    void        *pNew_node,
+    void        **ppOld_node);
+
+
 priq_err_t
 priq_node_change_priority(
     priq_t              *pHPriq,
@@ -135,6 +265,19 @@ priq_node_change_priority(
     void                *pNode);
 
 
+/**
+ *  change the priorities of 'num' nodes under one lock,
+ *  ppNodes[i] gets the priority pNew_pris[i].
+ *  small batch sifts per node, large batch rebuilds the whole heap.
+ */
+priq_err_t
+priq_node_change_priority_batch(
+    priq_t              *pHPriq,
+    void                **ppNodes,
+    priq_priority_t     *pNew_pris,
+    long                num);
+
+
 priq_err_t
 priq_node_peek(
     priq_t              *pHPriq,
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "binary_heap.h"
+
+typedef struct bench_node
+{
+    priq_priority_t     priority;
+    int                 pos;
+    char                payload[48];    // a node is a cache line, like a real request
+
+} bench_node_t;
+
+//////////////////////////////////
+static int
+_pri_cmp(priq_priority_t *pPri_a, priq_priority_t *pPri_b)
+{
+    return (pPri_a->u.u32_value > pPri_b->u.u32_value);
+}
+
+static priq_priority_t*
+_pri_get(void *pNode)
+{
+    return &((bench_node_t*)pNode)->priority;
+}
+
+static void
+_pri_set(void *pNode, priq_priority_t *pPri)
+{
+    ((bench_node_t*)pNode)->priority = *pPri;
+}
+
+static int
+_pos_get(void *pNode)
+{
+    return ((bench_node_t*)pNode)->pos;
+}
+
+static void
+_pos_set(void *pNode, int pos)
+{
+    ((bench_node_t*)pNode)->pos = pos;
+}
+
+static double
+_get_time_sec(void)
+{
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+_usage(const char *pProg)
+{
+    fprintf(stderr, "usage: %s <nodes> [insert buffer nodes] [scattered 0/1] [rounds]\n", pProg);
+}
+//////////////////////////////////
+int main(int argc, char **argv)
+{
+    priq_init_info_t    init_info = {0};
+    bench_node_t        *pNodes = 0;
+    int                 *pOrder = 0;
+    int                 i = 0, node_num = 0, is_scattered = 1, rounds = 5;
+    double              best_sec = 0.0;
+
+    if( argc < 2 || (node_num = atoi(argv[1])) <= 0 )
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    if( argc > 2 )
+        init_info.insert_buf_nodes = atoi(argv[2]);
+
+    if( argc > 3 )
+        is_scattered = atoi(argv[3]);
+
+    if( argc > 4 && atoi(argv[4]) > 0 )
+        rounds = atoi(argv[4]);
+
+    if( !(pNodes = malloc(sizeof(bench_node_t) * node_num)) ||
+        !(pOrder = malloc(sizeof(int) * node_num)) )
+    {
+        fprintf(stderr, "malloc %d nodes fail\n", node_num);
+        return 1;
+    }
+
+    // random keys, pushed in memory order or in a random order of the nodes
+    srand(1);
+    for(i = 0; i < node_num; i++)
+    {
+        pNodes[i].priority.u.u32_value = rand();
+        pOrder[i] = i;
+    }
+
+    for(i = node_num - 1; is_scattered && i > 0; i--)
+    {
+        int     j = rand() % (i + 1);
+        int     tmp = pOrder[i];
+
+        pOrder[i] = pOrder[j];
+        pOrder[j] = tmp;
+    }
+
+    init_info.amount_nodes = node_num;
+    init_info.cb_pri_get   = _pri_get;
+    init_info.cb_pri_set   = _pri_set;
+    init_info.cb_pri_cmp   = _pri_cmp;
+    init_info.cb_pos_get   = _pos_get;
+    init_info.cb_pos_set   = _pos_set;
+
+    while( rounds-- )
+    {
+        priq_t      *pHPriq = 0;
+        void        *pTop = 0;
+        double      t_start = 0.0, t_sec = 0.0;
+
+        if( priq_create(&pHPriq, &init_info) )
+        {
+            fprintf(stderr, "create queue fail\n");
+            return 1;
+        }
+
+        t_start = _get_time_sec();
+
+        for(i = 0; i < node_num; i++)
+            priq_node_push(pHPriq, &pNodes[pOrder[i]]);
+
+        // merge the rest of the insertion buffer
+        priq_node_peek(pHPriq, &pTop);
+
+        t_sec = _get_time_sec() - t_start;
+        if( best_sec == 0.0 || t_sec < best_sec )
+            best_sec = t_sec;
+
+        priq_destroy(&pHPriq);
+    }
+
+    printf("nodes   : %d (%s), insert buffer %d\n", node_num,
+           (is_scattered) ? "scattered" : "in order", init_info.insert_buf_nodes);
+    printf("ingest  : %.6f sec, %.1f ns/push\n", best_sec, best_sec * 1e9 / node_num);
+
+    free(pNodes);
+    free(pOrder);
+    return 0;
+}
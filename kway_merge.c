@@ -0,0 +1,546 @@
+/**
+ * Copyright (c) 2026 BinaryHeap contributors. All Rights Reserved.
+ */
+/** @file kway_merge.c
+ *
+ * @author BinaryHeap contributors
+ * @version 0.1
+ * @date 2026/10/19
+ * @license
+ * @description k-way merge of sorted runs on top of the binary heap
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "kway_merge.h"
+
+/**
+ *  one heap node per run, the priority of a node is its current record.
+ *  the top node is re-sifted once per output record (replace-top),
+ *  and a run is advanced lazily at the next call,
+ *  so the output record stays valid in the run buffer.
+ */
+
+//=============================================================================
+//                  Constant Definition
+//=============================================================================
+
+//=============================================================================
+//                  Macro Definition
+//=============================================================================
+#define err(str, args...)       fprintf(stderr, "%s[#%d] " str, __func__, __LINE__, ## args)
+
+
+#ifndef MEMBER_OFFSET
+    #define MEMBER_OFFSET(type, member)     (unsigned long)&(((type *)0)->member)
+#endif
+
+#ifndef STRUCTURE_POINTER
+    #define STRUCTURE_POINTER(type, ptr, member)    (type*)((unsigned long)ptr - MEMBER_OFFSET(type, member))
+#endif
+
+#define kmerge_verify_handle(handle, err_code)          \
+            do{ if(handle==NULL){                       \
+                err("%s", "input Null pointer !!\n");   \
+                return err_code;}                       \
+            }while(0)
+//=============================================================================
+//                  Structure Definition
+//=============================================================================
+struct kmerge_dev;
+
+typedef struct kmerge_node
+{
+    priq_priority_t     priority;   // u.ptr is the current record
+    int                 pos;
+
+    struct kmerge_dev   *pDev;
+    kmerge_run_t        *pRun;
+
+} kmerge_node_t;
+
+typedef struct kmerge_dev
+{
+    kmerge_t            hMerge;
+
+    priq_t              *pHPriq;
+
+    CB_RECORD_CMP       cb_rec_cmp;
+
+    kmerge_run_t        *pRuns;
+    int                 run_num;
+
+    kmerge_node_t       *pNodes;
+
+    // the node of the last output record, advanced at the next call
+    kmerge_node_t       *pLast_node;
+
+    // a run failed to read, the merged order is broken
+    int                 is_failed;
+
+} kmerge_dev_t;
+
+typedef struct file_run
+{
+    int             fd;
+    int             record_size;
+
+    unsigned char   *pBuf;
+    long            buf_size;
+    long            data_len;
+    long            rd_pos;
+
+    // mmap mode
+    unsigned char   *pMap;
+    long            map_size;
+
+} file_run_t;
+//=============================================================================
+//                  Global Data Definition
+//=============================================================================
+
+//=============================================================================
+//                  Private Function Definition
+//=============================================================================
+/**
+ *  the merge handle is found from the node of pPri_a,
+ *  it only works while the heap compares the priorities embedded in the nodes.
+ *  change_priority/remove compare a copied priority,
+ *  so the merge heap may only use push/push_batch/replace_top/pop/peek.
+ */
+static int
+_node_pri_cmp(
+    priq_priority_t     *pPri_a,
+    priq_priority_t     *pPri_b)
+{
+    kmerge_node_t   *pNode = STRUCTURE_POINTER(kmerge_node_t, pPri_a, priority);
+
+    return pNode->pDev->cb_rec_cmp(pPri_a->u.ptr, pPri_b->u.ptr);
+}
+
+static priq_priority_t*
+_node_pri_get(void *pNode)
+{
+    return &((kmerge_node_t*)pNode)->priority;
+}
+
+static void
+_node_pri_set(void *pNode, priq_priority_t *pPri)
+{
+    ((kmerge_node_t*)pNode)->priority = *pPri;
+}
+
+static int
+_node_pos_get(void *pNode)
+{
+    return ((kmerge_node_t*)pNode)->pos;
+}
+
+static void
+_node_pos_set(void *pNode, int pos)
+{
+    ((kmerge_node_t*)pNode)->pos = pos;
+}
+
+static kmerge_read_state_t
+_file_run_read(
+    void    *pRun_priv,
+    void    **ppRecord)
+{
+    file_run_t      *pFile_run = (file_run_t*)pRun_priv;
+
+    if( pFile_run->rd_pos + pFile_run->record_size > pFile_run->data_len )
+    {
+        long    remain = 0l;
+        ssize_t len = 0;
+
+        if( pFile_run->pMap )
+        {
+            if( pFile_run->rd_pos == pFile_run->data_len )
+                return KMERGE_READ_END;
+
+            err("truncated record at offset %ld\n", pFile_run->rd_pos);
+            return KMERGE_READ_ERROR;
+        }
+
+        // keep the partial record and refill the buffer
+        remain = pFile_run->data_len - pFile_run->rd_pos;
+        if( remain > 0 )
+            memmove(pFile_run->pBuf, pFile_run->pBuf + pFile_run->rd_pos, remain);
+
+        pFile_run->data_len = remain;
+        pFile_run->rd_pos   = 0l;
+
+        while( pFile_run->data_len < pFile_run->buf_size )
+        {
+            len = read(pFile_run->fd, pFile_run->pBuf + pFile_run->data_len,
+                       pFile_run->buf_size - pFile_run->data_len);
+            if( len < 0 )
+            {
+                if( errno == EINTR )
+                    continue;
+
+                err("read run fail, errno= %d\n", errno);
+                return KMERGE_READ_ERROR;
+            }
+
+            if( len == 0 )
+                break;
+
+            pFile_run->data_len += len;
+        }
+
+        if( pFile_run->data_len == 0 )
+            return KMERGE_READ_END;
+
+        if( pFile_run->data_len < pFile_run->record_size )
+        {
+            err("truncated record, %ld bytes left\n", pFile_run->data_len);
+            return KMERGE_READ_ERROR;
+        }
+    }
+
+    *ppRecord = pFile_run->pBuf + pFile_run->rd_pos;
+    pFile_run->rd_pos += pFile_run->record_size;
+
+    return KMERGE_READ_RECORD;
+}
+
+static void
+_file_run_close(void *pRun_priv)
+{
+    file_run_t      *pFile_run = (file_run_t*)pRun_priv;
+
+    if( !pFile_run )
+        return;
+
+    if( pFile_run->pMap )
+        munmap(pFile_run->pMap, pFile_run->map_size);
+    else if( pFile_run->pBuf )
+        free(pFile_run->pBuf);
+
+    if( pFile_run->fd >= 0 )
+        close(pFile_run->fd);
+
+    free(pFile_run);
+    return;
+}
+//=============================================================================
+//                  Public Function Definition
+//=============================================================================
+priq_err_t
+kmerge_create(
+    kmerge_t            **ppHMerge,
+    kmerge_init_info_t  *pInit_info)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    kmerge_dev_t    *pDev = 0;
+    void            **ppFirst_nodes = 0;
+
+    do {
+        priq_init_info_t    priq_info = {0};
+        int                 i = 0, node_num = 0;
+
+        if( !ppHMerge || (*ppHMerge) || !pInit_info ||
+            !pInit_info->pRuns || pInit_info->run_num <= 0 || !pInit_info->cb_rec_cmp )
+        {
+            err("%s", "input null pointer\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        if( !(pDev = malloc(sizeof(kmerge_dev_t))) )
+        {
+            err("malloc hanlde fail, size= %lu\n", sizeof(kmerge_dev_t));
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+
+        memset(pDev, 0x0, sizeof(kmerge_dev_t));
+
+        pDev->cb_rec_cmp = pInit_info->cb_rec_cmp;
+        pDev->pRuns      = pInit_info->pRuns;
+        pDev->run_num    = pInit_info->run_num;
+
+        if( !(pDev->pNodes = malloc(sizeof(kmerge_node_t) * pDev->run_num)) ||
+            !(ppFirst_nodes = malloc(sizeof(void*) * pDev->run_num)) )
+        {
+            err("malloc nodes fail, run num= %d\n", pDev->run_num);
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+        memset(pDev->pNodes, 0x0, sizeof(kmerge_node_t) * pDev->run_num);
+
+        priq_info.amount_nodes   = pDev->run_num;
+        priq_info.cb_pri_get     = _node_pri_get;
+        priq_info.cb_pri_set     = _node_pri_set;
+        priq_info.cb_pri_cmp     = _node_pri_cmp;
+        priq_info.cb_pos_get     = _node_pos_get;
+        priq_info.cb_pos_set     = _node_pos_set;
+        priq_info.worker_threads = pInit_info->worker_threads;
+        if( (rval = priq_create(&pDev->pHPriq, &priq_info)) )
+            break;
+
+        // load the first record of every run, then build the heap at once
+        for(i = 0; i < pDev->run_num; i++)
+        {
+            kmerge_node_t           *pNode = &pDev->pNodes[i];
+            void                    *pRecord = 0;
+            kmerge_read_state_t     state = KMERGE_READ_END;
+
+            pNode->pDev = pDev;
+            pNode->pRun = &pDev->pRuns[i];
+
+            if( pNode->pRun->cb_read )
+                state = pNode->pRun->cb_read(pNode->pRun->pRun_priv, &pRecord);
+
+            if( state == KMERGE_READ_ERROR )
+            {
+                err("read run %d fail\n", i);
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            if( state != KMERGE_READ_RECORD )
+                continue;
+
+            pNode->priority.u.ptr = pRecord;
+            ppFirst_nodes[node_num++] = pNode;
+        }
+
+        if( rval )
+            break;
+
+        if( (rval = priq_node_push_batch(pDev->pHPriq, ppFirst_nodes, node_num)) )
+            break;
+
+        pDev->hMerge.remain_runs = node_num;
+        //------------------------
+        *ppHMerge = &pDev->hMerge;
+
+    } while(0);
+
+    if( ppFirst_nodes )
+        free(ppFirst_nodes);
+
+    if( rval && pDev )
+    {
+        if( pDev->pHPriq )
+            priq_destroy(&pDev->pHPriq);
+
+        if( pDev->pNodes )
+            free(pDev->pNodes);
+
+        free(pDev);
+    }
+
+    return rval;
+}
+
+priq_err_t
+kmerge_destroy(kmerge_t  **ppHMerge)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+
+    do {
+        kmerge_dev_t    *pDev = 0;
+        int             i = 0;
+
+        if( !ppHMerge || !(*ppHMerge) )
+        {
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        pDev = STRUCTURE_POINTER(kmerge_dev_t, (*ppHMerge), hMerge);
+        *ppHMerge = 0;
+
+        for(i = 0; i < pDev->run_num; i++)
+        {
+            if( pDev->pRuns[i].cb_close )
+                pDev->pRuns[i].cb_close(pDev->pRuns[i].pRun_priv);
+        }
+
+        priq_destroy(&pDev->pHPriq);
+        free(pDev->pNodes);
+        free(pDev);
+
+    } while(0);
+
+    return rval;
+}
+
+priq_err_t
+kmerge_next(
+    kmerge_t    *pHMerge,
+    void        **ppRecord)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    kmerge_dev_t    *pDev = STRUCTURE_POINTER(kmerge_dev_t, pHMerge, hMerge);
+
+    kmerge_verify_handle(pHMerge, PRIQ_ERR_INVALID_PARAM);
+    kmerge_verify_handle(ppRecord, PRIQ_ERR_INVALID_PARAM);
+
+    do {
+        kmerge_node_t   *pNode = pDev->pLast_node;
+        void            *pRecord = 0;
+
+        *ppRecord = NULL;
+
+        if( pDev->is_failed )
+        {
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        // advance the run of the previous output record, it is still the top node
+        if( pNode )
+        {
+            void                    *pOld_node = 0;
+            kmerge_read_state_t     state = KMERGE_READ_END;
+
+            pDev->pLast_node = 0;
+
+            state = pNode->pRun->cb_read(pNode->pRun->pRun_priv, &pRecord);
+            if( state == KMERGE_READ_ERROR )
+            {
+                err("read run %d fail\n", (int)(pNode->pRun - pDev->pRuns));
+                pDev->is_failed = 1;
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            if( state == KMERGE_READ_RECORD )
+            {
+                pNode->priority.u.ptr = pRecord;
+                priq_node_replace_top(pDev->pHPriq, pNode, &pOld_node);
+            }
+            else
+            {
+                priq_node_pop(pDev->pHPriq, &pOld_node);
+                pDev->hMerge.remain_runs--;
+            }
+        }
+
+        if( pDev->hMerge.remain_runs == 0 )
+        {
+            rval = PRIQ_ERR_QUEUE_EMPTY;
+            break;
+        }
+
+        if( (rval = priq_node_peek(pDev->pHPriq, (void**)&pNode)) )
+            break;
+
+        pDev->pLast_node = pNode;
+        *ppRecord = pNode->priority.u.ptr;
+
+    } while(0);
+
+    return rval;
+}
+
+priq_err_t
+kmerge_file_run_open(
+    kmerge_run_t    *pRun,
+    const char      *pPath,
+    int             record_size,
+    int             buf_size,
+    int             is_mmap)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    file_run_t      *pFile_run = 0;
+
+    do {
+        if( !pRun || !pPath || record_size <= 0 )
+        {
+            err("%s", "input null pointer\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        if( !(pFile_run = malloc(sizeof(file_run_t))) )
+        {
+            err("malloc file run fail, size= %lu\n", sizeof(file_run_t));
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+
+        memset(pFile_run, 0x0, sizeof(file_run_t));
+        pFile_run->fd          = -1;
+        pFile_run->record_size = record_size;
+
+        if( (pFile_run->fd = open(pPath, O_RDONLY)) < 0 )
+        {
+            err("open '%s' fail\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        if( is_mmap )
+        {
+            struct stat     file_stat;
+
+            if( fstat(pFile_run->fd, &file_stat) )
+            {
+                err("stat '%s' fail\n", pPath);
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            // an empty file can't be mapped, it is an empty run
+            if( file_stat.st_size > 0 )
+            {
+                void    *pMap = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, pFile_run->fd, 0);
+
+                if( pMap == MAP_FAILED )
+                {
+                    err("mmap '%s' fail\n", pPath);
+                    rval = PRIQ_ERR_IO_FAIL;
+                    break;
+                }
+
+                madvise(pMap, file_stat.st_size, MADV_SEQUENTIAL);
+
+                pFile_run->pMap     = pMap;
+                pFile_run->map_size = file_stat.st_size;
+                pFile_run->pBuf     = pFile_run->pMap;
+                pFile_run->buf_size = pFile_run->map_size;
+                pFile_run->data_len = pFile_run->map_size;
+            }
+        }
+        else
+        {
+            // at least one record in the buffer
+            if( buf_size <= 0 )
+                buf_size = KMERGE_FILE_BUF_SIZE;
+
+            if( buf_size < record_size )
+                buf_size = record_size;
+
+            if( !(pFile_run->pBuf = malloc(buf_size)) )
+            {
+                err("malloc run buffer fail, size= %d\n", buf_size);
+                rval = PRIQ_ERR_MALLOC_FAIL;
+                break;
+            }
+
+            pFile_run->buf_size = buf_size;
+        }
+
+        pRun->cb_read   = _file_run_read;
+        pRun->cb_close  = _file_run_close;
+        pRun->pRun_priv = pFile_run;
+
+    } while(0);
+
+    if( rval && pFile_run )
+        _file_run_close(pFile_run);
+
+    return rval;
+}
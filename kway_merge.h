@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2026 BinaryHeap contributors. All Rights Reserved.
+ */
+/** @file kway_merge.h
+ *
+ * @author BinaryHeap contributors
+ * @version 0.1
+ * @date 2026/10/19
+ * @license
+ * @description k-way merge of sorted runs on top of the binary heap
+ */
+
+#ifndef __kway_merge_H_c3Xq81Rb_Tn0e_Ldw4_a6Gk_Vy2Mh5JsPoQ9__
+#define __kway_merge_H_c3Xq81Rb_Tn0e_Ldw4_a6Gk_Vy2Mh5JsPoQ9__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "binary_heap.h"
+//=============================================================================
+//                  Constant Definition
+//=============================================================================
+/**
+ *  default buffer size of a file run
+ */
+#define KMERGE_FILE_BUF_SIZE        (64 << 10)
+
+/**
+ *  the result of pulling a record from a run
+ */
+typedef enum kmerge_read_state
+{
+    KMERGE_READ_END     = 0,    // the run ends
+    KMERGE_READ_RECORD,         // *ppRecord is the next record
+    KMERGE_READ_ERROR,          // I/O error or a truncated record, the merge fails
+
+} kmerge_read_state_t;
+
+/** pull the next record of a sorted run */
+typedef kmerge_read_state_t (*CB_RUN_READ)(void *pRun_priv, void **ppRecord);
+
+/** release the private data of a run */
+typedef void (*CB_RUN_CLOSE)(void *pRun_priv);
+
+/**
+ *  compare 2 records, the same semantic as CB_PRIORITY_CMP
+ *  return 'true'   => pRecord_a is output after pRecord_b
+ *         'false'  => keep state
+ */
+typedef int (*CB_RECORD_CMP)(void *pRecord_a, void *pRecord_b);
+//=============================================================================
+//                  Macro Definition
+//=============================================================================
+
+//=============================================================================
+//                  Structure Definition
+//=============================================================================
+/**
+ *  a sorted run (file, stream, ...)
+ */
+typedef struct kmerge_run
+{
+    CB_RUN_READ     cb_read;
+    CB_RUN_CLOSE    cb_close;
+    void            *pRun_priv;
+
+} kmerge_run_t;
+
+/**
+ *  init info
+ */
+typedef struct kmerge_init_info
+{
+    kmerge_run_t    *pRuns;
+    int             run_num;
+
+    CB_RECORD_CMP   cb_rec_cmp;
+
+    int             worker_threads;
+
+} kmerge_init_info_t;
+
+/**
+ *  k-way merge handle
+ */
+typedef struct kmerge
+{
+    int         remain_runs;
+} kmerge_t;
+//=============================================================================
+//                  Global Data Definition
+//=============================================================================
+
+//=============================================================================
+//                  Private Function Definition
+//=============================================================================
+
+//=============================================================================
+//                  Public Function Definition
+//=============================================================================
+/**
+ *  the merge owns the runs only after it is created successfully.
+ *  when kmerge_create() fails (e.g. PRIQ_ERR_IO_FAIL at the first read),
+ *  the runs are left open and the caller closes them.
+ */
+priq_err_t
+kmerge_create(
+    kmerge_t            **ppHMerge,
+    kmerge_init_info_t  *pInit_info);
+
+
+/**
+ *  close all runs (cb_close) and release the handle
+ */
+priq_err_t
+kmerge_destroy(kmerge_t  **ppHMerge);
+
+
+/**
+ *  get the next record in merged order,
+ *  the record is valid until the next call.
+ *  return PRIQ_ERR_QUEUE_EMPTY when all runs end,
+ *         PRIQ_ERR_IO_FAIL when a run fails to read, the merge can't continue.
+ */
+priq_err_t
+kmerge_next(
+    kmerge_t    *pHMerge,
+    void        **ppRecord);
+
+
+/**
+ *  open a file of fixed-size sorted records as a run,
+ *  records are read through a 'buf_size' buffer or the file is mmap'ed.
+ *  a trailing partial record is a read error.
+ */
+priq_err_t
+kmerge_file_run_open(
+    kmerge_run_t    *pRun,
+    const char      *pPath,
+    int             record_size,
+    int             buf_size,
+    int             is_mmap);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,610 @@
+/**
+ * Copyright (c) 2026 BinaryHeap contributors. All Rights Reserved.
+ */
+/** @file priq_trace.c
+ *
+ * @author BinaryHeap contributors
+ * @version 0.1
+ * @date 2026/10/19
+ * @license
+ * @description record the operations of a priority queue and replay them
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "priq_trace.h"
+
+//=============================================================================
+//                  Constant Definition
+//=============================================================================
+
+//=============================================================================
+//                  Macro Definition
+//=============================================================================
+#define err(str, args...)       fprintf(stderr, "%s[#%d] " str, __func__, __LINE__, ## args)
+
+
+#ifndef MEMBER_OFFSET
+    #define MEMBER_OFFSET(type, member)     (unsigned long)&(((type *)0)->member)
+#endif
+
+#ifndef STRUCTURE_POINTER
+    #define STRUCTURE_POINTER(type, ptr, member)    (type*)((unsigned long)ptr - MEMBER_OFFSET(type, member))
+#endif
+
+#define trace_verify_handle(handle, err_code)           \
+            do{ if(handle==NULL){                       \
+                err("%s", "input Null pointer !!\n");   \
+                return err_code;}                       \
+            }while(0)
+//=============================================================================
+//                  Structure Definition
+//=============================================================================
+typedef struct trace_dev
+{
+    priq_trace_t            hTrace;
+
+    FILE                    *fp;
+    CB_NODE_ID              cb_node_id;
+
+    priq_trace_record_t     *pRecords;
+    long                    record_num;
+    long                    wr_idx;
+
+    // the records written to the file
+    unsigned long long      file_records;
+
+} trace_dev_t;
+
+typedef struct replay_node
+{
+    priq_priority_t     priority;
+    long long           pos;
+    int                 is_queued;
+
+} replay_node_t;
+//=============================================================================
+//                  Global Data Definition
+//=============================================================================
+
+//=============================================================================
+//                  Private Function Definition
+//=============================================================================
+static priq_err_t
+_trace_flush(trace_dev_t *pDev)
+{
+    if( !pDev->fp || !pDev->wr_idx )
+        return PRIQ_ERR_OK;
+
+    if( fwrite(pDev->pRecords, sizeof(priq_trace_record_t), pDev->wr_idx, pDev->fp) != (size_t)pDev->wr_idx )
+    {
+        err("%s", "write trace fail\n");
+
+        // the file is only valid up to 'file_records', stop writing it
+        pDev->hTrace.drop_records += pDev->wr_idx;
+        pDev->hTrace.last_err      = PRIQ_ERR_IO_FAIL;
+        pDev->wr_idx               = 0l;
+        return PRIQ_ERR_IO_FAIL;
+    }
+
+    pDev->file_records += pDev->wr_idx;
+    pDev->wr_idx        = 0l;
+    return PRIQ_ERR_OK;
+}
+
+static priq_err_t
+_trace_write_header(
+    FILE                *fp,
+    unsigned long long  record_num)
+{
+    priq_trace_header_t     header = {0};
+
+    header.magic      = PRIQ_TRACE_MAGIC;
+    header.version    = PRIQ_TRACE_VERSION;
+    header.record_num = record_num;
+
+    rewind(fp);
+    if( fwrite(&header, sizeof(header), 1, fp) != 1 )
+    {
+        err("%s", "write trace header fail\n");
+        return PRIQ_ERR_IO_FAIL;
+    }
+
+    return PRIQ_ERR_OK;
+}
+
+static int
+_replay_cmp_u64(
+    priq_priority_t     *pPri_a,
+    priq_priority_t     *pPri_b)
+{
+    return (pPri_a->u.u64_value > pPri_b->u.u64_value);
+}
+
+static priq_priority_t*
+_replay_pri_get(void *pNode)
+{
+    return &((replay_node_t*)pNode)->priority;
+}
+
+static void
+_replay_pri_set(void *pNode, priq_priority_t *pPri)
+{
+    ((replay_node_t*)pNode)->priority = *pPri;
+}
+
+static int
+_replay_pos_get(void *pNode)
+{
+    return (int)((replay_node_t*)pNode)->pos;
+}
+
+static void
+_replay_pos_set(void *pNode, int pos)
+{
+    ((replay_node_t*)pNode)->pos = pos;
+}
+
+static long long
+_replay_pos_get64(void *pNode)
+{
+    return ((replay_node_t*)pNode)->pos;
+}
+
+static void
+_replay_pos_set64(void *pNode, long long pos)
+{
+    ((replay_node_t*)pNode)->pos = pos;
+}
+
+static int
+_latency_cmp(const void *pA, const void *pB)
+{
+    unsigned long long  a = *(unsigned long long*)pA;
+    unsigned long long  b = *(unsigned long long*)pB;
+
+    return (a > b) - (a < b);
+}
+
+static unsigned long long
+_get_time_ns(void)
+{
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+//=============================================================================
+//                  Public Function Definition
+//=============================================================================
+priq_err_t
+priq_trace_create(
+    priq_trace_t            **ppHTrace,
+    priq_trace_init_info_t  *pInit_info)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    trace_dev_t     *pDev = 0;
+
+    do {
+        if( !ppHTrace || (*ppHTrace) || !pInit_info || !pInit_info->cb_node_id )
+        {
+            err("%s", "input null pointer\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        if( !(pDev = malloc(sizeof(trace_dev_t))) )
+        {
+            err("malloc hanlde fail, size= %lu\n", sizeof(trace_dev_t));
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+
+        memset(pDev, 0x0, sizeof(trace_dev_t));
+
+        pDev->cb_node_id = pInit_info->cb_node_id;
+        pDev->record_num = (pInit_info->record_num > 0) ? pInit_info->record_num : PRIQ_TRACE_RECORD_NUM;
+
+        if( !(pDev->pRecords = malloc(sizeof(priq_trace_record_t) * pDev->record_num)) )
+        {
+            err("malloc records fail, size= %lu\n", sizeof(priq_trace_record_t) * pDev->record_num);
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+
+        if( pInit_info->pPath )
+        {
+            if( !(pDev->fp = fopen(pInit_info->pPath, "wb")) )
+            {
+                err("open '%s' fail\n", pInit_info->pPath);
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            // the record number is updated when destroy
+            if( (rval = _trace_write_header(pDev->fp, 0ull)) )
+                break;
+        }
+
+        //------------------------
+        *ppHTrace = &pDev->hTrace;
+
+    } while(0);
+
+    if( rval && pDev )
+    {
+        if( pDev->fp )
+            fclose(pDev->fp);
+
+        if( pDev->pRecords )
+            free(pDev->pRecords);
+
+        free(pDev);
+    }
+
+    return rval;
+}
+
+priq_err_t
+priq_trace_destroy(priq_trace_t  **ppHTrace)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+
+    do {
+        trace_dev_t     *pDev = 0;
+
+        if( !ppHTrace || !(*ppHTrace) )
+        {
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        pDev = STRUCTURE_POINTER(trace_dev_t, (*ppHTrace), hTrace);
+        *ppHTrace = 0;
+
+        if( pDev->fp )
+        {
+            if( !pDev->hTrace.last_err )
+                _trace_flush(pDev);
+
+            // a failed trace is still readable up to the last good write
+            rval = _trace_write_header(pDev->fp, pDev->file_records);
+            if( pDev->hTrace.last_err )
+                rval = pDev->hTrace.last_err;
+
+            if( fclose(pDev->fp) && !rval )
+            {
+                err("%s", "close trace fail\n");
+                rval = PRIQ_ERR_IO_FAIL;
+            }
+        }
+
+        free(pDev->pRecords);
+        free(pDev);
+
+    } while(0);
+
+    return rval;
+}
+
+void
+priq_trace_record(
+    void                *pTrace_priv,
+    priq_op_t           op,
+    void                *pNode,
+    priq_priority_t     *pPri)
+{
+    trace_dev_t             *pDev = STRUCTURE_POINTER(trace_dev_t, pTrace_priv, hTrace);
+    priq_trace_record_t     *pRecord = 0;
+
+    if( !pTrace_priv )
+        return;
+
+    pDev->hTrace.total_records++;
+
+    if( pDev->hTrace.last_err )
+    {
+        pDev->hTrace.drop_records++;
+        return;
+    }
+
+    pRecord = &pDev->pRecords[pDev->wr_idx++];
+    pRecord->key     = pPri->u.u64_value;
+    pRecord->node_id = pDev->cb_node_id(pNode);
+    pRecord->op      = (unsigned int)op;
+
+    if( pDev->wr_idx == pDev->record_num )
+    {
+        // file mode flushes a full buffer, ring mode wraps around
+        if( pDev->fp )
+            _trace_flush(pDev);
+        else
+            pDev->wr_idx = 0l;
+    }
+
+    return;
+}
+
+priq_err_t
+priq_trace_save(
+    priq_trace_t    *pHTrace,
+    const char      *pPath)
+{
+    priq_err_t      rval = PRIQ_ERR_OK;
+    trace_dev_t     *pDev = STRUCTURE_POINTER(trace_dev_t, pHTrace, hTrace);
+    FILE            *fp = 0;
+
+    trace_verify_handle(pHTrace, PRIQ_ERR_INVALID_PARAM);
+
+    do {
+        long    valid_num = 0l, old_idx = 0l;
+
+        if( pDev->fp )
+        {
+            if( (rval = pHTrace->last_err) )
+                break;
+
+            if( !(rval = _trace_flush(pDev)) && fflush(pDev->fp) )
+            {
+                err("%s", "flush trace fail\n");
+                pHTrace->last_err = rval = PRIQ_ERR_IO_FAIL;
+            }
+            break;
+        }
+
+        if( !pPath )
+        {
+            err("%s", "input null pointer\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        if( !(fp = fopen(pPath, "wb")) )
+        {
+            err("open '%s' fail\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        // the oldest record is at wr_idx after the ring wrapped around
+        if( pHTrace->total_records > (unsigned long long)pDev->record_num )
+        {
+            valid_num = pDev->record_num;
+            old_idx   = pDev->wr_idx;
+        }
+        else
+        {
+            valid_num = (long)pHTrace->total_records;
+            old_idx   = 0l;
+        }
+
+        if( (rval = _trace_write_header(fp, valid_num)) )
+            break;
+
+        if( fwrite(&pDev->pRecords[old_idx], sizeof(priq_trace_record_t), valid_num - old_idx, fp) != (size_t)(valid_num - old_idx) ||
+            fwrite(pDev->pRecords, sizeof(priq_trace_record_t), old_idx, fp) != (size_t)old_idx )
+        {
+            err("write '%s' fail\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+    } while(0);
+
+    if( fp )
+        fclose(fp);
+
+    return rval;
+}
+
+priq_err_t
+priq_trace_replay(
+    const char              *pPath,
+    priq_init_info_t        *pInit_info,
+    priq_replay_report_t    *pReport)
+{
+    priq_err_t              rval = PRIQ_ERR_OK;
+    FILE                    *fp = 0;
+    priq_trace_record_t     *pRecords = 0;
+    replay_node_t           *pNodes = 0;
+    unsigned long long      *pLatency = 0;
+    priq_t                  *pHPriq = 0;
+
+    do {
+        priq_trace_header_t     header = {0};
+        priq_init_info_t        init_info = {0};
+        unsigned long long      i = 0ull, t_start = 0ull, t_end = 0ull;
+        unsigned int            max_id = 0;
+
+        if( !pPath || !pInit_info || !pReport )
+        {
+            err("%s", "input null pointer\n");
+            rval = PRIQ_ERR_INVALID_PARAM;
+            break;
+        }
+
+        memset(pReport, 0x0, sizeof(priq_replay_report_t));
+
+        if( !(fp = fopen(pPath, "rb")) )
+        {
+            err("open '%s' fail\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        if( fread(&header, sizeof(header), 1, fp) != 1 ||
+            header.magic != PRIQ_TRACE_MAGIC || header.version != PRIQ_TRACE_VERSION )
+        {
+            err("'%s' isn't a trace file\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        {
+            long                file_size = 0l;
+            unsigned long long  file_num = 0ull;
+
+            if( fseek(fp, 0l, SEEK_END) || (file_size = ftell(fp)) < (long)sizeof(header) ||
+                fseek(fp, (long)sizeof(header), SEEK_SET) )
+            {
+                err("get size of '%s' fail\n", pPath);
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+
+            // a partial record at the tail is left by a crashed recorder
+            file_num = (unsigned long long)(file_size - sizeof(header)) / sizeof(priq_trace_record_t);
+
+            if( !header.record_num )
+                header.record_num = file_num;
+
+            if( header.record_num > file_num )
+            {
+                err("'%s' is truncated, %llu/%llu records\n", pPath, file_num, header.record_num);
+                rval = PRIQ_ERR_IO_FAIL;
+                break;
+            }
+        }
+
+        if( !header.record_num )
+            break;
+
+        if( !(pRecords = malloc(sizeof(priq_trace_record_t) * header.record_num)) ||
+            !(pLatency = malloc(sizeof(unsigned long long) * header.record_num)) )
+        {
+            err("malloc records fail, num= %llu\n", header.record_num);
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+
+        if( fread(pRecords, sizeof(priq_trace_record_t), header.record_num, fp) != header.record_num )
+        {
+            err("read '%s' fail\n", pPath);
+            rval = PRIQ_ERR_IO_FAIL;
+            break;
+        }
+
+        for(i = 0; i < header.record_num; i++)
+        {
+            if( pRecords[i].node_id > max_id )
+                max_id = pRecords[i].node_id;
+        }
+
+        if( !(pNodes = malloc(sizeof(replay_node_t) * ((size_t)max_id + 1))) )
+        {
+            err("malloc nodes fail, num= %u\n", max_id + 1);
+            rval = PRIQ_ERR_MALLOC_FAIL;
+            break;
+        }
+        memset(pNodes, 0x0, sizeof(replay_node_t) * ((size_t)max_id + 1));
+
+        // keep the engine configuration, use the replay nodes
+        init_info = *pInit_info;
+        if( init_info.amount_nodes <= 0 && init_info.amount_nodes64 <= 0 )
+            init_info.amount_nodes64 = (long long)max_id + 1;
+
+        // the 64-bit position callbacks are preferred, replace them as well
+        init_info.cb_pri_get    = _replay_pri_get;
+        init_info.cb_pri_set    = _replay_pri_set;
+        init_info.cb_pos_get    = _replay_pos_get;
+        init_info.cb_pos_set    = _replay_pos_set;
+        init_info.cb_pos_get64  = _replay_pos_get64;
+        init_info.cb_pos_set64  = _replay_pos_set64;
+        init_info.cb_pri_cmp    = (pInit_info->cb_pri_cmp) ? pInit_info->cb_pri_cmp : _replay_cmp_u64;
+        init_info.cb_trace      = 0;
+        init_info.pTrace_priv   = 0;
+
+        if( (rval = priq_create(&pHPriq, &init_info)) )
+            break;
+
+        t_start = _get_time_ns();
+
+        for(i = 0; i < header.record_num; i++)
+        {
+            priq_trace_record_t     *pRecord = &pRecords[i];
+            replay_node_t           *pNode = &pNodes[pRecord->node_id];
+            priq_priority_t         pri = {{0}};
+            unsigned long long      t_op = 0ull;
+
+            pri.u.u64_value = pRecord->key;
+
+            // the queue of this replay may diverge from the trace (e.g. another cmp)
+            if( (pRecord->op == PRIQ_OP_PUSH && pNode->is_queued) ||
+                (pRecord->op == PRIQ_OP_POP && !pHPriq->remain_num) ||
+                (pRecord->op != PRIQ_OP_PUSH && pRecord->op != PRIQ_OP_POP && !pNode->is_queued) )
+            {
+                pReport->skip_num++;
+                continue;
+            }
+
+            t_op = _get_time_ns();
+
+            switch( pRecord->op )
+            {
+                case PRIQ_OP_PUSH:
+                    pNode->priority = pri;
+                    if( !priq_node_push(pHPriq, pNode) )
+                        pNode->is_queued = 1;
+                    break;
+
+                case PRIQ_OP_POP:
+                    {
+                        replay_node_t   *pPop_node = 0;
+
+                        if( !priq_node_pop(pHPriq, (void**)&pPop_node) )
+                            pPop_node->is_queued = 0;
+                    }
+                    break;
+
+                case PRIQ_OP_CHANGE_PRIORITY:
+                    priq_node_change_priority(pHPriq, &pri, pNode);
+                    break;
+
+                case PRIQ_OP_REMOVE:
+                    priq_node_remove(pHPriq, pNode);
+                    pNode->is_queued = 0;
+                    break;
+
+                default:
+                    break;
+            }
+
+            pLatency[pReport->op_num++] = _get_time_ns() - t_op;
+        }
+
+        t_end = _get_time_ns();
+
+        if( !pReport->op_num )
+            break;
+
+        qsort(pLatency, pReport->op_num, sizeof(unsigned long long), _latency_cmp);
+
+        pReport->total_sec   = (double)(t_end - t_start) / 1e9;
+        pReport->ops_per_sec = (pReport->total_sec > 0.0) ? (double)pReport->op_num / pReport->total_sec : 0.0;
+        pReport->lat_p50     = pLatency[(pReport->op_num * 50) / 100];
+        pReport->lat_p90     = pLatency[(pReport->op_num * 90) / 100];
+        pReport->lat_p99     = pLatency[(pReport->op_num * 99) / 100];
+        pReport->lat_p999    = pLatency[(pReport->op_num * 999) / 1000];
+        pReport->lat_max     = pLatency[pReport->op_num - 1];
+
+    } while(0);
+
+    if( pHPriq )
+        priq_destroy(&pHPriq);
+
+    if( fp )
+        fclose(fp);
+
+    if( pRecords )
+        free(pRecords);
+
+    if( pLatency )
+        free(pLatency);
+
+    if( pNodes )
+        free(pNodes);
+
+    return rval;
+}
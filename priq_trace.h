@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2026 BinaryHeap contributors. All Rights Reserved.
+ */
+/** @file priq_trace.h
+ *
+ * @author BinaryHeap contributors
+ * @version 0.1
+ * @date 2026/10/19
+ * @license
+ * @description record the operations of a priority queue and replay them
+ */
+
+#ifndef __priq_trace_H_m4Rw0Tz7_Kb2s_Pq9e_Hx3L_c8NvYd1GuJ6a__
+#define __priq_trace_H_m4Rw0Tz7_Kb2s_Pq9e_Hx3L_c8NvYd1GuJ6a__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "binary_heap.h"
+//=============================================================================
+//                  Constant Definition
+//=============================================================================
+#define PRIQ_TRACE_MAGIC            0x52545150  // "PQTR"
+#define PRIQ_TRACE_VERSION          1
+
+/**
+ *  default amount of records in the ring/write buffer
+ */
+#define PRIQ_TRACE_RECORD_NUM       (64 << 10)
+
+/** callback function to get the ID of a node, it is saved in the trace */
+typedef unsigned int (*CB_NODE_ID)(void *pNode);
+//=============================================================================
+//                  Macro Definition
+//=============================================================================
+
+//=============================================================================
+//                  Structure Definition
+//=============================================================================
+/**
+ *  trace file: a header and then the records
+ */
+typedef struct priq_trace_header
+{
+    unsigned int        magic;
+    unsigned int        version;
+    unsigned long long  record_num;
+
+} priq_trace_header_t;
+
+typedef struct priq_trace_record
+{
+    unsigned long long  key;        // priority u64_value
+    unsigned int        node_id;
+    unsigned int        op;         // priq_op_t
+
+} priq_trace_record_t;
+
+/**
+ *  init info
+ */
+typedef struct priq_trace_init_info
+{
+    /**
+     *  pPath != NULL => records are flushed to the file per 'record_num'
+     *  pPath == NULL => in-memory ring buffer, keep the last 'record_num' records
+     */
+    const char      *pPath;
+    int             record_num;
+
+    CB_NODE_ID      cb_node_id;
+
+} priq_trace_init_info_t;
+
+/**
+ *  trace handle
+ */
+typedef struct priq_trace
+{
+    unsigned long long  total_records;
+
+    /**
+     *  file mode: records lost by a failed write, 'last_err' keeps the error
+     *  and the following records are dropped as well.
+     */
+    unsigned long long  drop_records;
+    priq_err_t          last_err;
+
+} priq_trace_t;
+
+/**
+ *  replay report
+ */
+typedef struct priq_replay_report
+{
+    unsigned long long  op_num;
+    unsigned long long  skip_num;   // ops on nodes not in the queue of this replay
+
+    double              total_sec;
+    double              ops_per_sec;
+
+    // latency per operation (ns)
+    unsigned long long  lat_p50;
+    unsigned long long  lat_p90;
+    unsigned long long  lat_p99;
+    unsigned long long  lat_p999;
+    unsigned long long  lat_max;
+
+} priq_replay_report_t;
+//=============================================================================
+//                  Global Data Definition
+//=============================================================================
+
+//=============================================================================
+//                  Private Function Definition
+//=============================================================================
+
+//=============================================================================
+//                  Public Function Definition
+//=============================================================================
+priq_err_t
+priq_trace_create(
+    priq_trace_t            **ppHTrace,
+    priq_trace_init_info_t  *pInit_info);
+
+
+/**
+ *  flush the records to the file (file mode) and release the handle,
+ *  return the write error of the trace if any.
+ */
+priq_err_t
+priq_trace_destroy(priq_trace_t  **ppHTrace);
+
+
+/**
+ *  the CB_TRACE_OP of a queue,
+ *  set priq_init_info_t.cb_trace = priq_trace_record and pTrace_priv = the trace handle.
+ *  one trace handle per queue, it is protected by the queue lock.
+ */
+void
+priq_trace_record(
+    void                *pTrace_priv,
+    priq_op_t           op,
+    void                *pNode,
+    priq_priority_t     *pPri);
+
+
+/**
+ *  file mode: flush the buffered records
+ *  ring mode: write the records in the ring buffer (oldest first) to pPath
+ */
+priq_err_t
+priq_trace_save(
+    priq_trace_t    *pHTrace,
+    const char      *pPath);
+
+
+/**
+ *  run a trace file against a queue created from pInit_info,
+ *  a trace with record_num 0 in the header (the recorder didn't finish)
+ *  is replayed with the complete records in the file.
+ *  the priority/position callbacks are replaced by the replay nodes,
+ *  the keys are compared with cb_pri_cmp (u64_value, min first, if NULL).
+ */
+priq_err_t
+priq_trace_replay(
+    const char              *pPath,
+    priq_init_info_t        *pInit_info,
+    priq_replay_report_t    *pReport);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
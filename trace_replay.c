@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "priq_trace.h"
+
+//////////////////////////////////
+static void
+_usage(const char *pProg)
+{
+    fprintf(stderr, "usage: %s <trace file> [worker threads] [combining slots] [B-heap page nodes] [insert buffer nodes]\n", pProg);
+}
+//////////////////////////////////
+int main(int argc, char **argv)
+{
+    priq_init_info_t        init_info = {0};
+    priq_replay_report_t    report = {0};
+
+    if( argc < 2 )
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    if( argc > 2 )
+        init_info.worker_threads = atoi(argv[2]);
+
+    if( argc > 3 )
+        init_info.fc_slots = atoi(argv[3]);
+
+    if( argc > 4 )
+    {
+        init_info.layout     = PRIQ_LAYOUT_BHEAP;
+        init_info.page_nodes = atol(argv[4]);
+    }
+
+    if( argc > 5 )
+        init_info.insert_buf_nodes = atoi(argv[5]);
+
+    if( priq_trace_replay(argv[1], &init_info, &report) )
+    {
+        fprintf(stderr, "replay '%s' fail\n", argv[1]);
+        return 1;
+    }
+
+    printf("ops     : %llu (skip %llu)\n", report.op_num, report.skip_num);
+    printf("time    : %.6f sec, %.0f ops/sec\n", report.total_sec, report.ops_per_sec);
+    printf("latency : p50 %llu ns, p90 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+           report.lat_p50, report.lat_p90, report.lat_p99, report.lat_p999, report.lat_max);
+
+    return 0;
+}